@@ -0,0 +1,45 @@
+#include "bench_port.h"
+#include "MAX7219/MAX7219_port.h"
+#include <stddef.h>
+
+bench_counters_t bench_counters;
+
+// The port only counts; shifting the bytes out is the SPI peripheral's
+// job, its cost is estimated from spi_bytes in the report.
+volatile uint8_t bench_port_sink;
+
+esp_err_t max7219_port_init(void){
+    return ESP_OK;
+}
+
+void max7219_port_write(const uint8_t *buf, size_t len){
+    bench_counters.spi_tx++;
+    bench_counters.spi_bytes += len;
+    bench_port_sink = buf[len - 1];
+}
+
+void max7219_port_lock(void){}
+void max7219_port_unlock(void){}
+
+// Allocation counting by interposing the C allocator (glibc).
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size){
+    bench_counters.allocs++;
+    bench_counters.alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size){
+    bench_counters.allocs++;
+    bench_counters.alloc_bytes += n * size;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size){
+    bench_counters.allocs++;
+    bench_counters.alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+}
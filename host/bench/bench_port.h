@@ -0,0 +1,16 @@
+#ifndef BENCH_PORT_H
+#define BENCH_PORT_H
+
+#include <stdint.h>
+
+// Counters kept by the benchmark's MAX7219 port and allocator hooks.
+typedef struct {
+    uint64_t spi_tx;     // chain transactions
+    uint64_t spi_bytes;  // bytes shifted out
+    uint64_t allocs;     // malloc/calloc/realloc calls
+    uint64_t alloc_bytes;
+} bench_counters_t;
+
+extern bench_counters_t bench_counters;
+
+#endif
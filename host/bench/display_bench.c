@@ -0,0 +1,375 @@
+// Microbenchmarks for the display hot paths.
+//
+// Every case runs one unit of work per iteration ("op"), normally one frame
+// worth of it, and reports host ns/op together with what the firmware would
+// have to move for it: MAX7219 chain transactions, SPI bytes (and the time
+// they take on the 10 MHz bus) and heap allocations.
+//
+//   display_bench                    human readable table
+//   display_bench --json             one JSON object per line, for tracking
+//   display_bench --filter draw_     only cases whose name contains draw_
+//
+// New implementations of a hot path get their own case next to the one
+// they replace, so both numbers stay comparable across releases.
+//
+// After the table comes what the gray_plane_load case means for grayscale
+// (main/gray): how many bit-planes per second the bus can latch and the
+// fastest refresh each plane count can reach.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "MAX7219/MAX7219.h"
+#include "marquee/marquee.h"
+#include "font/font.h"
+#include "font_file.h"
+#include "gray/gray.h"
+#include "bench_port.h"
+
+#define BENCH_REPEATS    5
+// CS stays high this long after every chain transaction (MAX7219_spi.c)
+#define BENCH_LATCH_US   2.0
+// A plane may take at most this share of the shortest slot to load, or
+// the least significant plane shows visibly brighter than it should.
+#define BENCH_GRAY_SLOT_PER_LOAD 8
+
+typedef struct {
+    const char *name;
+    const char *what;           // what one op is
+    void (*setup)(void);
+    void (*run)(uint64_t iter);
+} bench_case_t;
+
+typedef struct {
+    double ns_per_op;
+    double spi_tx_per_op;
+    double spi_bytes_per_op;
+    double spi_us_per_op;
+    double allocs_per_op;
+    uint64_t iters;
+} bench_result_t;
+
+static volatile uint32_t bench_sink;
+
+static const char *bench_text = "HELLO LPU! WE ARE CIRCUIT CRAFTERS.";
+static marquee_t bench_mq;
+static uint8_t bench_buf[MARQUEE_BUF_LEN];
+
+/* ---- cases ---- */
+
+static void setup_marquee(void){
+    marquee_init(&bench_mq, bench_text, strlen(bench_text));
+    memset(bench_buf, 0, sizeof(bench_buf));
+}
+
+static void run_push_col(uint64_t iter){
+    push_col(bench_buf, (uint8_t)(iter * 0x9D));
+    bench_sink += bench_buf[7];
+}
+
+static void run_glyph_lookup(uint64_t iter){
+    // once per character of the default message: mostly cache hits
+    const font_glyph_t *g = font_glyph((uint8_t)bench_text[iter % 35]);
+    bench_sink += g->cols[0];
+}
+
+static void run_glyph_lookup_miss(uint64_t iter){
+    // FONT_CACHE_SLOTS apart, so every lookup evicts: index search + decode
+    const font_glyph_t *g = font_glyph(0x20 + (uint32_t)(iter % 3) * FONT_CACHE_SLOTS);
+    bench_sink += g->cols[0];
+}
+
+static void run_utf8_decode(uint64_t iter){
+    static const char s[] = "Caf\xc3\xa9 \xe2\x82\xb9" "50";
+    int used;
+    int off = (int)(iter % 8);
+    bench_sink += font_utf8_next(s + off, (int)sizeof(s) - 1 - off, &used);
+}
+
+static void run_marquee_step(uint64_t iter){
+    (void)iter;
+    marquee_step(&bench_mq);
+    bench_sink += bench_mq.buf[31];
+}
+
+static void run_draw_buffer(uint64_t iter){
+    (void)iter;
+    draw_buffer(bench_buf);
+}
+
+static void run_marquee_frame(uint64_t iter){
+    (void)iter;
+    marquee_step(&bench_mq);
+    draw_buffer(bench_mq.buf);
+    max7219_commit();
+}
+
+// Worst case vsync: marquee and clock both change in the same commit.
+static void run_full_frame(uint64_t iter){
+    int s = (int)(iter % 86400);
+    marquee_step(&bench_mq);
+    draw_buffer(bench_mq.buf);
+    draw_time(s / 3600, s / 60 % 60, s % 60);
+    max7219_commit();
+}
+
+static void run_commit_idle(uint64_t iter){
+    (void)iter;
+    max7219_commit();
+}
+
+static void run_scrub_slice(uint64_t iter){
+    (void)iter;
+    max7219_scrub(NUM_MODULES * 2);
+}
+
+static void run_draw_time(uint64_t iter){
+    int s = (int)(iter % 86400);
+    draw_time(s / 3600, s / 60 % 60, s % 60);
+}
+
+static void run_clock_frame(uint64_t iter){
+    run_draw_time(iter);
+    max7219_commit();
+}
+
+static void run_draw_weather(uint64_t iter){
+    weather_data_t w = {.temp = 10 + (int)(iter % 40), .wind_speed = (int)(iter % 60)};
+    draw_weather(w);
+}
+
+static void run_max7219_send(uint64_t iter){
+    max7219_send((int)(iter % NUM_MODULES), 1 + (iter & 7), (uint8_t)iter);
+}
+
+static void run_max7219_send_all(uint64_t iter){
+    max7219_send_all(0x0A, (uint8_t)(iter & 0x0F));
+}
+
+static void run_set_all_brightness(uint64_t iter){
+    set_all_brightness((uint8_t)(iter & 0x0F));
+}
+
+static uint8_t bench_levels[NUM_MODULES * 64];
+
+// Marquee zone as a ramp from off to full, the clock in plain rows
+static void setup_gray_ramp(void){
+    for (int i = 0; i < 4 * 64; i++) {
+        bench_levels[i] = (uint8_t)((i % 8 + i / 64 * 8) * 255 / 31);
+    }
+    max7219_gray_begin(MAX7219_GRAY_BITS_MAX);
+    draw_zone_levels(8, 4, bench_levels);
+    draw_time(12, 34, 56);
+    max7219_commit();
+}
+
+// Every column lit in exactly one plane, a different one in its
+// neighbours: consecutive planes differ in every row of every module.
+static void setup_gray_worst(void){
+    for (int i = 0; i < NUM_MODULES * 64; i++) {
+        bench_levels[i] = (uint8_t)(0x20 << (i % 8 % 3));
+    }
+    max7219_gray_begin(MAX7219_GRAY_BITS_MAX);
+    draw_zone_levels(0, NUM_MODULES, bench_levels);
+    max7219_commit();
+}
+
+static void run_draw_zone_levels(uint64_t iter){
+    (void)iter;
+    draw_zone_levels(8, 4, bench_levels);
+}
+
+static void run_gray_plane_load(uint64_t iter){
+    max7219_gray_show((int)(iter % MAX7219_GRAY_BITS_MAX));
+}
+
+static void run_gray_cycle(uint64_t iter){
+    (void)iter;
+    for (int plane = 0; plane < MAX7219_GRAY_BITS_MAX; plane++) {
+        max7219_gray_show(plane);
+    }
+}
+
+static const bench_case_t bench_cases[] = {
+    {"push_col",           "column",  setup_marquee, run_push_col},
+    {"glyph_lookup",       "glyph",   NULL,          run_glyph_lookup},
+    {"glyph_lookup_miss",  "glyph",   NULL,          run_glyph_lookup_miss},
+    {"utf8_decode",        "char",    NULL,          run_utf8_decode},
+    {"marquee_step",       "column",  setup_marquee, run_marquee_step},
+    {"draw_buffer",        "frame",   setup_marquee, run_draw_buffer},
+    {"marquee_frame",      "frame",   setup_marquee, run_marquee_frame},
+    {"full_frame",         "frame",   setup_marquee, run_full_frame},
+    {"commit_idle",        "frame",   NULL,          run_commit_idle},
+    {"scrub_slice",        "slice",   NULL,          run_scrub_slice},
+    {"draw_time",          "frame",   NULL,          run_draw_time},
+    {"clock_frame",        "frame",   NULL,          run_clock_frame},
+    {"draw_weather",       "frame",   NULL,          run_draw_weather},
+    {"max7219_send",       "register", NULL,         run_max7219_send},
+    {"max7219_send_all",   "register", NULL,         run_max7219_send_all},
+    {"set_all_brightness", "call",    NULL,          run_set_all_brightness},
+    // Last: these leave the driver in grayscale
+    {"draw_zone_levels",   "zone",    setup_gray_ramp,  run_draw_zone_levels},
+    {"gray_cycle",         "cycle",   setup_gray_ramp,  run_gray_cycle},
+    {"gray_plane_load",    "plane",   setup_gray_worst, run_gray_plane_load},
+};
+
+/* ---- harness ---- */
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static bench_result_t bench_run(const bench_case_t *c, uint64_t min_ns){
+    bench_result_t r = {0};
+
+    // size the batch so one repeat takes about min_ns
+    uint64_t iters = 1;
+    while (1) {
+        if (c->setup) c->setup();
+        uint64_t t0 = now_ns();
+        for (uint64_t i = 0; i < iters; i++) c->run(i);
+        uint64_t dt = now_ns() - t0;
+        if (dt >= min_ns / 4 || iters >= (1ull << 32)) {
+            if (dt < min_ns && dt > 0) iters = iters * min_ns / dt;
+            break;
+        }
+        iters *= 4;
+    }
+    if (iters == 0) iters = 1;
+
+    double ns[BENCH_REPEATS];
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        if (c->setup) c->setup();
+        bench_counters_t before = bench_counters;
+        uint64_t t0 = now_ns();
+        for (uint64_t i = 0; i < iters; i++) c->run(i);
+        uint64_t dt = now_ns() - t0;
+        ns[rep] = (double)dt / (double)iters;
+
+        if (rep == 0) {
+            r.spi_tx_per_op = (double)(bench_counters.spi_tx - before.spi_tx) / iters;
+            r.spi_bytes_per_op = (double)(bench_counters.spi_bytes - before.spi_bytes) / iters;
+            r.allocs_per_op = (double)(bench_counters.allocs - before.allocs) / iters;
+        }
+    }
+    qsort(ns, BENCH_REPEATS, sizeof(ns[0]), cmp_double);
+    r.ns_per_op = ns[BENCH_REPEATS / 2];
+    r.spi_us_per_op = r.spi_bytes_per_op * 8.0 * 1e6 / MAX7219_SPI_HZ;
+    r.iters = iters;
+    return r;
+}
+
+// What the worst case plane load allows: the bus time of one plane plus
+// the latch delay per transaction (the host's ns/op says little about the
+// device and is left out), and for each plane count the shortest cycle
+// whose 1-unit slot is still BENCH_GRAY_SLOT_PER_LOAD plane loads long.
+static void gray_report(const bench_result_t *load, bool json){
+    double plane_us = load->spi_us_per_op + load->spi_tx_per_op * BENCH_LATCH_US;
+    if (plane_us <= 0) {
+        return;
+    }
+    if (!json) {
+        printf("\ngrayscale: %.1f us per worst case plane (%.0f transactions), %.0f planes/s\n",
+               plane_us, load->spi_tx_per_op, 1e6 / plane_us);
+        printf("%-5s %12s %10s %11s %s\n", "bits", "unit_min_us", "cycle_us", "refresh_hz",
+               "at GRAY_CYCLE_US");
+    }
+    for (int bits = 2; bits <= MAX7219_GRAY_BITS_MAX; bits++) {
+        int units = (1 << bits) - 1;
+        double unit_us = plane_us * BENCH_GRAY_SLOT_PER_LOAD;
+        double cycle_us = unit_us * units;
+        double fw_unit_us = (double)GRAY_CYCLE_US / units;
+        double share = plane_us / fw_unit_us;  // of the firmware's 1-unit slot
+        if (json) {
+            printf("{\"bench\":\"gray_plane_rate\",\"bits\":%d,\"plane_us\":%.2f,"
+                   "\"planes_per_s\":%.0f,\"unit_min_us\":%.1f,\"cycle_min_us\":%.1f,"
+                   "\"refresh_max_hz\":%.1f,\"fw_cycle_us\":%d,\"fw_load_share\":%.3f}\n",
+                   bits, plane_us, 1e6 / plane_us, unit_us, cycle_us, 1e6 / cycle_us,
+                   GRAY_CYCLE_US, share);
+        } else {
+            printf("%-5d %12.1f %10.1f %11.1f load is %.0f%% of the %.0f us unit\n",
+                   bits, unit_us, cycle_us, 1e6 / cycle_us, share * 100, fw_unit_us);
+        }
+    }
+}
+
+int main(int argc, char **argv){
+    bool json = false;
+    const char *filter = NULL;
+    uint64_t min_ns = 200ull * 1000 * 1000;
+
+    static const struct option long_opts[] = {
+        {"json",     no_argument,       NULL, 'j'},
+        {"filter",   required_argument, NULL, 'f'},
+        {"min-time", required_argument, NULL, 'm'},
+        {"list",     no_argument,       NULL, 'l'},
+        {"help",     no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'j': json = true; break;
+            case 'f': filter = optarg; break;
+            case 'm': min_ns = strtoull(optarg, NULL, 10) * 1000 * 1000; break;
+            case 'l':
+                for (size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++) {
+                    printf("%s\n", bench_cases[i].name);
+                }
+                return 0;
+            default:
+                fprintf(stderr,
+                    "usage: %s [--json] [--filter SUBSTR] [--min-time MS] [--list]\n", argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    const char *font_path = NULL;
+#ifdef HOST_FONT_PATH
+    font_path = HOST_FONT_PATH;
+#endif
+    if (font_path && font_load_file(font_path) != ESP_OK) {
+        fprintf(stderr, "%s: not a usable font, benchmarking the built-in table\n", font_path);
+    }
+
+    if (!json) {
+        printf("%-20s %-9s %12s %8s %10s %10s %8s\n",
+               "bench", "op", "ns/op", "spi_tx", "spi_bytes", "spi_us", "allocs");
+    }
+    bench_result_t gray_load = {0};
+    for (size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++) {
+        const bench_case_t *c = &bench_cases[i];
+        if (filter && !strstr(c->name, filter)) {
+            continue;
+        }
+        bench_result_t r = bench_run(c, min_ns);
+        if (c->run == run_gray_plane_load) {
+            gray_load = r;
+        }
+        if (json) {
+            printf("{\"bench\":\"%s\",\"op\":\"%s\",\"ns_per_op\":%.2f,\"iters\":%llu,"
+                   "\"spi_tx_per_op\":%.2f,\"spi_bytes_per_op\":%.2f,\"spi_us_per_op\":%.2f,"
+                   "\"allocs_per_op\":%.4f}\n",
+                   c->name, c->what, r.ns_per_op, (unsigned long long)r.iters,
+                   r.spi_tx_per_op, r.spi_bytes_per_op, r.spi_us_per_op, r.allocs_per_op);
+        } else {
+            printf("%-20s %-9s %12.2f %8.2f %10.2f %10.2f %8.4f\n",
+                   c->name, c->what, r.ns_per_op, r.spi_tx_per_op,
+                   r.spi_bytes_per_op, r.spi_us_per_op, r.allocs_per_op);
+        }
+        fflush(stdout);
+    }
+    gray_report(&gray_load, json);
+    return 0;
+}
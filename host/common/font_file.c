@@ -0,0 +1,33 @@
+#include "font_file.h"
+#include "font/font.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+esp_err_t font_load_file(const char *path){
+    static uint8_t *blob;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *buf = len > 0 ? malloc((size_t)len) : NULL;
+    if (!buf || fread(buf, 1, (size_t)len, f) != (size_t)len) {
+        free(buf);
+        fclose(f);
+        return ESP_FAIL;
+    }
+    fclose(f);
+
+    esp_err_t ret = font_load(buf, (size_t)len);
+    if (ret != ESP_OK) {
+        free(buf);
+        return ret;
+    }
+    free(blob);
+    blob = buf;
+    return ESP_OK;
+}
@@ -0,0 +1,10 @@
+#ifndef FONT_FILE_H
+#define FONT_FILE_H
+
+#include "esp_err.h"
+
+// Host stand-in for font_init(): read a CPF1 blob from a file instead of
+// mapping the flash partition. The blob stays allocated while active.
+esp_err_t font_load_file(const char *path);
+
+#endif
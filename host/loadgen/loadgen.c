@@ -0,0 +1,527 @@
+#define _GNU_SOURCE  // memmem
+
+// Virtual-device load generator.
+//
+// Runs N simulated signs against an MQTT broker, each one a separate MQTT
+// connection that behaves like the firmware: it announces itself on its
+// status topic, sends the heartbeat every MQTT_HEARTBEAT_MS, subscribes to
+// its command topics and acks fan-out jobs. Topic handling is the
+// firmware's own (main/MQTT/mqtt_topics.c).
+//
+//   mqtt_loadgen --broker localhost --steps 100,500,1000
+//   mqtt_loadgen --broker localhost --server localhost:3000
+//                --server-pid $(pgrep -f server.js) --steps 100,500,1000
+//
+// Every step connects more devices (the earlier ones stay), then runs for
+// --phase seconds and reports:
+//   msg   command -> device latency. With --server the command is a POST
+//         /api/fanout to the web app (group "all"), without it the load
+//         generator publishes each device's copy itself (broker only).
+//   hb    heartbeat publish -> the device showing up on the dashboard
+//         WebSocket (needs --server).
+//   cpu   web app CPU from /proc/<pid>/stat (needs --server-pid), and the
+//         load generator's own, which must stay well below one core for
+//         the other numbers to mean anything.
+
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "MQTT/mqtt_topics.h"
+#include "mqtt_lite.h"
+#include "web_lite.h"
+
+#define LOADGEN_MAX_STEPS 16
+
+typedef struct {
+    char id[32];
+    mqtt_lite_t mq;
+    bool subscribed;
+    int64_t started_us;
+    int64_t next_hb_us;
+    int64_t hb_sent_us;   // heartbeat not yet seen on the dashboard, 0 if none
+    int64_t cmd_sent_us;  // direct mode: when this device's command went out
+    uint32_t cmd_seq;     // last command seen, to count each one once
+} vdev_t;
+
+typedef struct {
+    int64_t *v;
+    size_t n, cap;
+} samples_t;
+
+typedef struct {
+    const char *broker_host;
+    int broker_port;
+    const char *server_host;  // NULL: direct mode
+    int server_port;
+    int steps[LOADGEN_MAX_STEPS];
+    int num_steps;
+    int phase_s;
+    int heartbeat_ms;
+    int command_ms;
+    const char *prefix;
+    int server_pid;
+    bool json;
+} loadgen_opts_t;
+
+static loadgen_opts_t opts;
+static vdev_t *vdevs;
+static int num_vdevs;
+
+static mqtt_lite_t control;       // direct mode publisher
+static web_ws_t dashboard = {.fd = -1};
+
+static uint32_t cmd_seq;          // current command, part of the job id
+static int64_t cmd_start_us;
+static samples_t msg_lat, hb_lat;
+static int msg_expected, msg_received;
+
+static int64_t now_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sample_add(samples_t *s, int64_t v){
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 1024;
+        s->v = realloc(s->v, s->cap * sizeof(s->v[0]));
+    }
+    s->v[s->n++] = v;
+}
+
+static int cmp_i64(const void *a, const void *b){
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_ms(samples_t *s, double p){
+    if (s->n == 0) return 0.0;
+    size_t i = (size_t)(p * (double)(s->n - 1) + 0.5);
+    return (double)s->v[i] / 1000.0;
+}
+
+// Device ids are <prefix><index>, so the dashboard side can map an id
+// back to its device without a lookup table.
+static vdev_t *vdev_by_id(const char *id, size_t len){
+    size_t plen = strlen(opts.prefix);
+    if (len <= plen || strncmp(id, opts.prefix, plen) != 0) return NULL;
+    int idx = 0;
+    for (size_t i = plen; i < len; i++) {
+        if (id[i] < '0' || id[i] > '9') return NULL;
+        idx = idx * 10 + (id[i] - '0');
+    }
+    return idx < num_vdevs ? &vdevs[idx] : NULL;
+}
+
+static void vdev_publish(vdev_t *d, const char *kind, const char *payload, size_t len){
+    char topic[MQTT_TOPIC_MAX];
+    mqtt_topic_format(topic, sizeof(topic), kind, d->id);
+    mqtt_lite_publish(&d->mq, topic, payload, len, 1);
+}
+
+// Same handling as MQTT_EVENT_DATA in MQTT.c, minus the display.
+static void vdev_on_publish(mqtt_lite_t *c, const char *topic, int topic_len,
+                            const uint8_t *payload, int len){
+    vdev_t *d = c->user;
+    mqtt_cmd_t cmd;
+    (void)payload;
+    (void)len;
+    if (!mqtt_cmd_parse(d->id, topic, topic_len, &cmd)) {
+        return;
+    }
+    bool is_message = cmd.kind_len == 7 && memcmp(cmd.kind, "message", 7) == 0;
+
+    if (is_message && d->cmd_seq != cmd_seq) {
+        int64_t sent = opts.server_host ? cmd_start_us : d->cmd_sent_us;
+        d->cmd_seq = cmd_seq;
+        sample_add(&msg_lat, now_us() - sent);
+        msg_received++;
+    }
+
+    char ack[96];
+    int ack_len = mqtt_ack_payload(ack, sizeof(ack), cmd.job, cmd.job_len);
+    if (ack_len > 0) {
+        vdev_publish(d, "ack", ack, (size_t)ack_len);
+    }
+}
+
+// Any device of ours in a dashboard update: its heartbeat has arrived.
+static void dashboard_on_text(web_ws_t *ws, const char *text, size_t len){
+    static const char key[] = "\"id\":\"";
+    const char *p = text, *end = text + len;
+    int64_t now = now_us();
+    (void)ws;
+
+    while ((p = memmem(p, (size_t)(end - p), key, sizeof(key) - 1)) != NULL) {
+        p += sizeof(key) - 1;
+        const char *q = memchr(p, '"', (size_t)(end - p));
+        if (q == NULL) break;
+        vdev_t *d = vdev_by_id(p, (size_t)(q - p));
+        if (d && d->hb_sent_us) {
+            sample_add(&hb_lat, now - d->hb_sent_us);
+            d->hb_sent_us = 0;
+        }
+        p = q;
+    }
+}
+
+static int vdev_start(int idx){
+    vdev_t *d = &vdevs[idx];
+    char client_id[64];
+    snprintf(d->id, sizeof(d->id), "%s%05d", opts.prefix, idx);
+    snprintf(client_id, sizeof(client_id), "loadgen_%s", d->id);
+    d->mq.on_publish = vdev_on_publish;
+    d->mq.user = d;
+    d->subscribed = false;
+    d->cmd_seq = 0;
+    return mqtt_lite_connect(&d->mq, opts.broker_host, opts.broker_port, client_id, 60);
+}
+
+// Same payload shape and size as the firmware's status heartbeat.
+static void vdev_publish_status(vdev_t *d, int64_t now){
+    char payload[128];
+    mqtt_status_t st = {
+        .uptime_s = (uint32_t)((now - d->started_us) / 1000000),
+        .rssi = -60,
+        .free_heap = 180000,
+        .fps_x10 = 500,
+    };
+    int len = mqtt_status_payload(payload, sizeof(payload), &st);
+    vdev_publish(d, "status", payload, (size_t)len);
+}
+
+// What MQTT_EVENT_CONNECTED does in the firmware.
+static void vdev_on_connected(vdev_t *d, int64_t now){
+    char topic[MQTT_TOPIC_MAX];
+    d->started_us = now;
+    vdev_publish_status(d, now);
+
+    mqtt_cmd_filter_format(topic, sizeof(topic), d->id);
+    mqtt_lite_subscribe(&d->mq, topic, 1);
+    mqtt_cmd_filter_format(topic, sizeof(topic), MQTT_BROADCAST_ID);
+    mqtt_lite_subscribe(&d->mq, topic, 1);
+
+    d->subscribed = true;
+    // spread heartbeats over the interval like a real fleet
+    d->next_hb_us = now + (int64_t)(rand() % opts.heartbeat_ms) * 1000;
+}
+
+static void send_command(int64_t now){
+    char job[24];
+    cmd_seq++;
+    cmd_start_us = now;
+    snprintf(job, sizeof(job), "lg%u", cmd_seq);
+
+    if (opts.server_host) {
+        char resp[512];
+        int status = web_post_json(opts.server_host, opts.server_port, "/api/fanout",
+                                   "{\"groups\":[\"all\"],\"message\":\"LOAD TEST\"}",
+                                   resp, sizeof(resp));
+        if (status != 202) {
+            fprintf(stderr, "fan-out failed (%d): %s\n", status, resp);
+            return;
+        }
+    } else {
+        char topic[MQTT_TOPIC_MAX + 24];
+        for (int i = 0; i < num_vdevs; i++) {
+            if (!vdevs[i].subscribed) continue;
+            mqtt_cmd_topic_format(topic, sizeof(topic), vdevs[i].id, "message");
+            strcat(topic, "/");
+            strcat(topic, job);
+            vdevs[i].cmd_sent_us = now_us();
+            mqtt_lite_publish(&control, topic, "LOAD TEST", 9, 1);
+        }
+    }
+
+    for (int i = 0; i < num_vdevs; i++) {
+        if (vdevs[i].subscribed) msg_expected++;
+    }
+}
+
+static int64_t cpu_ticks_of(int pid){
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return -1;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    // fields after "(comm)": state is field 3, utime 14, stime 15
+    char *p = strrchr(buf, ')');
+    long long utime, stime;
+    if (p == NULL ||
+        sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lld %lld", &utime, &stime) != 2) {
+        return -1;
+    }
+    return utime + stime;
+}
+
+static double self_cpu_s(void){
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static void run_loop_until(int64_t deadline, bool commands){
+    struct pollfd *pfd = calloc((size_t)num_vdevs + 2, sizeof(*pfd));
+    int64_t next_cmd = now_us() + (int64_t)opts.command_ms * 1000;
+
+    while (1) {
+        int64_t now = now_us();
+        if (now >= deadline) break;
+
+        if (commands && now >= next_cmd) {
+            send_command(now);
+            next_cmd += (int64_t)opts.command_ms * 1000;
+        }
+        for (int i = 0; i < num_vdevs; i++) {
+            vdev_t *d = &vdevs[i];
+            if (d->subscribed && now >= d->next_hb_us) {
+                vdev_publish_status(d, now);
+                if (d->hb_sent_us == 0) d->hb_sent_us = now;
+                d->next_hb_us += (int64_t)opts.heartbeat_ms * 1000;
+            }
+        }
+
+        int n = 0;
+        for (int i = 0; i < num_vdevs; i++) {
+            pfd[n++] = (struct pollfd){.fd = vdevs[i].mq.fd, .events = POLLIN};
+        }
+        pfd[n++] = (struct pollfd){.fd = control.fd, .events = POLLIN};
+        pfd[n++] = (struct pollfd){.fd = dashboard.fd, .events = POLLIN};
+        if (poll(pfd, (nfds_t)n, 5) <= 0) continue;
+
+        for (int i = 0; i < num_vdevs; i++) {
+            vdev_t *d = &vdevs[i];
+            if (!(pfd[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            if (mqtt_lite_read(&d->mq) < 0) {
+                fprintf(stderr, "%s: connection lost\n", d->id);
+                mqtt_lite_close(&d->mq);
+                d->subscribed = false;
+                continue;
+            }
+            if (d->mq.connected && !d->subscribed) {
+                vdev_on_connected(d, now_us());
+            }
+        }
+        if (pfd[num_vdevs].revents & POLLIN) {
+            mqtt_lite_read(&control);
+        }
+        if ((pfd[num_vdevs + 1].revents & POLLIN) && web_ws_read(&dashboard) < 0) {
+            fprintf(stderr, "dashboard WebSocket closed\n");
+            web_ws_close(&dashboard);
+        }
+    }
+    free(pfd);
+}
+
+static void report_step(int devices, int connected, double connect_ms,
+                        double server_cpu, double self_cpu){
+    qsort(msg_lat.v, msg_lat.n, sizeof(int64_t), cmp_i64);
+    qsort(hb_lat.v, hb_lat.n, sizeof(int64_t), cmp_i64);
+
+    if (opts.json) {
+        printf("{\"devices\":%d,\"connected\":%d,\"connect_ms\":%.1f,"
+               "\"msg_expected\":%d,\"msg_received\":%d,"
+               "\"msg_p50_ms\":%.2f,\"msg_p95_ms\":%.2f,\"msg_p99_ms\":%.2f,\"msg_max_ms\":%.2f,"
+               "\"hb_n\":%zu,\"hb_p50_ms\":%.2f,\"hb_p95_ms\":%.2f,\"hb_p99_ms\":%.2f,"
+               "\"server_cpu_pct\":%.1f,\"loadgen_cpu_pct\":%.1f}\n",
+               devices, connected, connect_ms, msg_expected, msg_received,
+               percentile_ms(&msg_lat, 0.5), percentile_ms(&msg_lat, 0.95),
+               percentile_ms(&msg_lat, 0.99), percentile_ms(&msg_lat, 1.0),
+               hb_lat.n, percentile_ms(&hb_lat, 0.5), percentile_ms(&hb_lat, 0.95),
+               percentile_ms(&hb_lat, 0.99), server_cpu, self_cpu);
+    } else {
+        printf("%7d %9d %10.1f %7d/%-7d %8.2f %8.2f %8.2f %6zu %8.2f %8.2f %8.2f %7.1f %7.1f\n",
+               devices, connected, connect_ms, msg_received, msg_expected,
+               percentile_ms(&msg_lat, 0.5), percentile_ms(&msg_lat, 0.95),
+               percentile_ms(&msg_lat, 0.99),
+               hb_lat.n, percentile_ms(&hb_lat, 0.5), percentile_ms(&hb_lat, 0.95),
+               percentile_ms(&hb_lat, 0.99), server_cpu, self_cpu);
+    }
+    fflush(stdout);
+}
+
+static int parse_host_port(char *arg, const char **host, int *port){
+    char *colon = strrchr(arg, ':');
+    if (colon) {
+        *colon = '\0';
+        *port = atoi(colon + 1);
+    }
+    *host = arg;
+    return *port > 0 ? 0 : -1;
+}
+
+static void usage(const char *argv0){
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --broker HOST[:PORT]   MQTT broker (default 127.0.0.1:1883)\n"
+        "  --server HOST[:PORT]   web app to drive fan-outs and watch (default: none)\n"
+        "  --server-pid PID       sample the web app's CPU\n"
+        "  --steps N1,N2,...      devices per step (default 10,50,100)\n"
+        "  --phase S              seconds per step (default 30)\n"
+        "  --heartbeat MS         heartbeat period (default %d)\n"
+        "  --command-every MS     command period (default 5000)\n"
+        "  --prefix STR           device id prefix (default vdev)\n"
+        "  --json                 one JSON object per step\n",
+        argv0, MQTT_HEARTBEAT_MS);
+}
+
+int main(int argc, char **argv){
+    opts = (loadgen_opts_t){
+        .broker_host = "127.0.0.1", .broker_port = 1883,
+        .server_port = 3000,
+        .steps = {10, 50, 100}, .num_steps = 3,
+        .phase_s = 30,
+        .heartbeat_ms = MQTT_HEARTBEAT_MS,
+        .command_ms = 5000,
+        .prefix = "vdev",
+    };
+
+    static const struct option long_opts[] = {
+        {"broker",        required_argument, NULL, 'b'},
+        {"server",        required_argument, NULL, 's'},
+        {"server-pid",    required_argument, NULL, 'p'},
+        {"steps",         required_argument, NULL, 'n'},
+        {"phase",         required_argument, NULL, 't'},
+        {"heartbeat",     required_argument, NULL, 'H'},
+        {"command-every", required_argument, NULL, 'c'},
+        {"prefix",        required_argument, NULL, 'x'},
+        {"json",          no_argument,       NULL, 'j'},
+        {"help",          no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'b':
+                if (parse_host_port(optarg, &opts.broker_host, &opts.broker_port) < 0) {
+                    fprintf(stderr, "bad --broker\n");
+                    return 2;
+                }
+                break;
+            case 's':
+                if (parse_host_port(optarg, &opts.server_host, &opts.server_port) < 0) {
+                    fprintf(stderr, "bad --server\n");
+                    return 2;
+                }
+                break;
+            case 'p': opts.server_pid = atoi(optarg); break;
+            case 'n': {
+                opts.num_steps = 0;
+                for (char *tok = strtok(optarg, ","); tok && opts.num_steps < LOADGEN_MAX_STEPS;
+                     tok = strtok(NULL, ",")) {
+                    opts.steps[opts.num_steps++] = atoi(tok);
+                }
+                break;
+            }
+            case 't': opts.phase_s = atoi(optarg); break;
+            case 'H': opts.heartbeat_ms = atoi(optarg); break;
+            case 'c': opts.command_ms = atoi(optarg); break;
+            case 'x': opts.prefix = optarg; break;
+            case 'j': opts.json = true; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (opts.heartbeat_ms <= 0 || opts.command_ms <= 0 || opts.phase_s <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // one socket per device
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    int max_devices = 0;
+    for (int i = 0; i < opts.num_steps; i++) {
+        if (opts.steps[i] > max_devices) max_devices = opts.steps[i];
+    }
+    vdevs = calloc((size_t)max_devices, sizeof(*vdevs));
+    for (int i = 0; i < max_devices; i++) vdevs[i].mq.fd = -1;
+    control.fd = -1;
+
+    if (opts.server_host) {
+        dashboard.on_text = dashboard_on_text;
+        int ret = web_ws_connect(&dashboard, opts.server_host, opts.server_port, "/");
+        if (ret < 0) {
+            fprintf(stderr, "dashboard %s:%d: %s\n", opts.server_host, opts.server_port, strerror(-ret));
+            return 1;
+        }
+    } else {
+        int ret = mqtt_lite_connect(&control, opts.broker_host, opts.broker_port, "loadgen_control", 60);
+        if (ret < 0) {
+            fprintf(stderr, "broker %s:%d: %s\n", opts.broker_host, opts.broker_port, strerror(-ret));
+            return 1;
+        }
+    }
+
+    if (!opts.json) {
+        printf("%7s %9s %10s %15s %8s %8s %8s %6s %8s %8s %8s %7s %7s\n",
+               "devices", "connected", "connect_ms", "msg rx/expected", "msg_p50", "msg_p95", "msg_p99",
+               "hb_n", "hb_p50", "hb_p95", "hb_p99", "srv_cpu", "gen_cpu");
+    }
+
+    for (int step = 0; step < opts.num_steps; step++) {
+        int target = opts.steps[step];
+        int64_t t0 = now_us();
+
+        // connect the new devices, then wait for all of them to be up
+        for (int i = num_vdevs; i < target; i++) {
+            int ret = vdev_start(i);
+            if (ret < 0) {
+                fprintf(stderr, "device %d: %s\n", i, strerror(-ret));
+                target = i;
+                break;
+            }
+        }
+        num_vdevs = target;
+        int64_t settle = now_us() + 10 * 1000000LL;
+        int connected = 0;
+        while (now_us() < settle) {
+            run_loop_until(now_us() + 50000, false);
+            connected = 0;
+            for (int i = 0; i < num_vdevs; i++) connected += vdevs[i].subscribed;
+            if (connected == num_vdevs) break;
+        }
+        double connect_ms = (double)(now_us() - t0) / 1000.0;
+
+        // measure
+        msg_lat.n = hb_lat.n = 0;
+        msg_expected = msg_received = 0;
+        for (int i = 0; i < num_vdevs; i++) vdevs[i].hb_sent_us = 0;
+        int64_t cpu0 = opts.server_pid ? cpu_ticks_of(opts.server_pid) : -1;
+        double self0 = self_cpu_s();
+        int64_t m0 = now_us();
+
+        run_loop_until(m0 + (int64_t)opts.phase_s * 1000000, true);
+
+        double wall_s = (double)(now_us() - m0) / 1e6;
+        int64_t cpu1 = opts.server_pid ? cpu_ticks_of(opts.server_pid) : -1;
+        double server_cpu = (cpu0 >= 0 && cpu1 >= 0)
+            ? 100.0 * (double)(cpu1 - cpu0) / (double)sysconf(_SC_CLK_TCK) / wall_s : 0.0;
+        double self_cpu = 100.0 * (self_cpu_s() - self0) / wall_s;
+
+        report_step(num_vdevs, connected, connect_ms, server_cpu, self_cpu);
+    }
+
+    for (int i = 0; i < num_vdevs; i++) mqtt_lite_close(&vdevs[i].mq);
+    mqtt_lite_close(&control);
+    web_ws_close(&dashboard);
+    free(vdevs);
+    return 0;
+}
@@ -0,0 +1,232 @@
+#include "mqtt_lite.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#define PKT_CONNECT    0x10
+#define PKT_CONNACK    0x20
+#define PKT_PUBLISH    0x30
+#define PKT_PUBACK     0x40
+#define PKT_SUBSCRIBE  0x82  // reserved flags 0010
+#define PKT_SUBACK     0x90
+#define PKT_PINGREQ    0xC0
+#define PKT_PINGRESP   0xD0
+
+// Whole packet or nothing: the socket is non-blocking, wait it out when
+// the kernel buffer is full rather than tearing a packet.
+static int send_all(int fd, const uint8_t *buf, size_t len){
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n > 0) {
+            buf += n;
+            len -= (size_t)n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd p = {.fd = fd, .events = POLLOUT};
+            poll(&p, 1, 1000);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return -errno;
+        }
+    }
+    return 0;
+}
+
+static uint16_t next_packet_id(mqtt_lite_t *c){
+    if (c->next_id == 0) c->next_id = 1;  // 0 is not a valid packet id
+    return c->next_id++;
+}
+
+static size_t put_len(uint8_t *p, size_t len){
+    size_t i = 0;
+    do {
+        uint8_t b = len % 128;
+        len /= 128;
+        p[i++] = len ? (b | 0x80) : b;
+    } while (len);
+    return i;
+}
+
+static size_t put_str(uint8_t *p, const char *s, size_t len){
+    p[0] = (uint8_t)(len >> 8);
+    p[1] = (uint8_t)len;
+    memcpy(p + 2, s, len);
+    return len + 2;
+}
+
+// Fixed header in front of a variable part built at body + 5.
+static int send_packet(mqtt_lite_t *c, uint8_t type, uint8_t *buf, size_t body_len){
+    uint8_t hdr[5];
+    hdr[0] = type;
+    size_t n = 1 + put_len(hdr + 1, body_len);
+    uint8_t *start = buf + 5 - n;
+    memcpy(start, hdr, n);
+    return send_all(c->fd, start, n + body_len);
+}
+
+int mqtt_lite_connect(mqtt_lite_t *c, const char *host, int port,
+                      const char *client_id, int keepalive_s){
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *res;
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    if (getaddrinfo(host, port_str, &hints, &res) != 0) {
+        return -EHOSTUNREACH;
+    }
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) < 0) {
+        int err = errno;
+        if (fd >= 0) close(fd);
+        freeaddrinfo(res);
+        return -err;
+    }
+    freeaddrinfo(res);
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    c->fd = fd;
+    c->connected = false;
+    c->next_id = 1;
+    c->rx_len = 0;
+
+    uint8_t buf[5 + 12 + 2 + 128];
+    uint8_t *p = buf + 5;
+    size_t id_len = strnlen(client_id, 128);
+    p += put_str(p, "MQTT", 4);
+    *p++ = 4;     // protocol level 3.1.1
+    *p++ = 0x02;  // clean session
+    *p++ = (uint8_t)(keepalive_s >> 8);
+    *p++ = (uint8_t)keepalive_s;
+    p += put_str(p, client_id, id_len);
+    return send_packet(c, PKT_CONNECT, buf, (size_t)(p - (buf + 5)));
+}
+
+void mqtt_lite_close(mqtt_lite_t *c){
+    if (c->fd >= 0) {
+        close(c->fd);
+    }
+    c->fd = -1;
+    c->connected = false;
+}
+
+int mqtt_lite_subscribe(mqtt_lite_t *c, const char *topic, int qos){
+    uint8_t buf[5 + 2 + 2 + 256 + 1];
+    size_t topic_len = strnlen(topic, 256);
+    uint8_t *p = buf + 5;
+    uint16_t id = next_packet_id(c);
+    *p++ = (uint8_t)(id >> 8);
+    *p++ = (uint8_t)id;
+    p += put_str(p, topic, topic_len);
+    *p++ = (uint8_t)qos;
+    return send_packet(c, PKT_SUBSCRIBE, buf, (size_t)(p - (buf + 5)));
+}
+
+int mqtt_lite_publish(mqtt_lite_t *c, const char *topic, const void *payload,
+                      size_t len, int qos){
+    uint8_t buf[5 + 2 + 256 + 2 + 1024];
+    size_t topic_len = strnlen(topic, 256);
+    if (len > 1024) {
+        return -EMSGSIZE;
+    }
+    uint8_t *p = buf + 5;
+    p += put_str(p, topic, topic_len);
+    if (qos > 0) {
+        uint16_t id = next_packet_id(c);
+        *p++ = (uint8_t)(id >> 8);
+        *p++ = (uint8_t)id;
+    }
+    memcpy(p, payload, len);
+    p += len;
+    return send_packet(c, PKT_PUBLISH | (qos > 0 ? 0x02 : 0x00), buf, (size_t)(p - (buf + 5)));
+}
+
+int mqtt_lite_ping(mqtt_lite_t *c){
+    uint8_t buf[5];
+    return send_packet(c, PKT_PINGREQ, buf, 0);
+}
+
+static void handle_packet(mqtt_lite_t *c, uint8_t type, const uint8_t *body, size_t len){
+    switch (type & 0xF0) {
+        case PKT_CONNACK:
+            c->connected = len >= 2 && body[1] == 0;
+            break;
+        case PKT_PUBLISH: {
+            int qos = (type >> 1) & 0x03;
+            if (len < 2) return;
+            size_t topic_len = ((size_t)body[0] << 8) | body[1];
+            size_t off = 2 + topic_len;
+            uint16_t id = 0;
+            if (qos > 0) {
+                if (off + 2 > len) return;
+                id = (uint16_t)((body[off] << 8) | body[off + 1]);
+                off += 2;
+            }
+            if (off > len) return;
+            if (c->on_publish) {
+                c->on_publish(c, (const char *)body + 2, (int)topic_len, body + off, (int)(len - off));
+            }
+            if (qos > 0) {
+                uint8_t ack[5 + 2];
+                ack[5] = (uint8_t)(id >> 8);
+                ack[6] = (uint8_t)id;
+                send_packet(c, PKT_PUBACK, ack, 2);
+            }
+            break;
+        }
+        default:
+            break;  // PUBACK, SUBACK, PINGRESP: nothing to track
+    }
+}
+
+int mqtt_lite_read(mqtt_lite_t *c){
+    while (1) {
+        ssize_t n = recv(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, 0);
+        if (n == 0) {
+            return -1;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        c->rx_len += (size_t)n;
+
+        // dispatch every complete packet in the buffer
+        size_t pos = 0;
+        while (pos + 2 <= c->rx_len) {
+            size_t len = 0, mult = 1, i = pos + 1;
+            bool complete = false;
+            for (int k = 0; k < 4 && i < c->rx_len; k++, i++) {
+                len += (c->rx[i] & 0x7F) * mult;
+                mult *= 128;
+                if (!(c->rx[i] & 0x80)) {
+                    complete = true;
+                    i++;
+                    break;
+                }
+            }
+            if (!complete || i + len > c->rx_len) {
+                if (complete && i - pos + len > sizeof(c->rx)) {
+                    return -1;  // larger than anything we subscribe to
+                }
+                break;
+            }
+            handle_packet(c, c->rx[pos], c->rx + i, len);
+            pos = i + len;
+        }
+        memmove(c->rx, c->rx + pos, c->rx_len - pos);
+        c->rx_len -= pos;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef MQTT_LITE_H
+#define MQTT_LITE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Just enough MQTT 3.1.1 for the load generator: CONNECT, SUBSCRIBE,
+// PUBLISH at QoS 0/1 both ways, PUBACK and PINGREQ. One non-blocking
+// socket per client; the caller polls mqtt_lite_fd() and calls
+// mqtt_lite_read() when it is readable. Incoming PUBLISHes are handed to
+// on_publish (topic and payload are not NUL terminated) and QoS 1 ones
+// are acknowledged right after.
+
+#define MQTT_LITE_RX_MAX 4096
+
+typedef struct mqtt_lite mqtt_lite_t;
+
+typedef void (*mqtt_lite_publish_cb_t)(mqtt_lite_t *c, const char *topic, int topic_len,
+                                       const uint8_t *payload, int len);
+
+struct mqtt_lite {
+    int fd;
+    bool connected;          // CONNACK accepted
+    uint16_t next_id;
+    mqtt_lite_publish_cb_t on_publish;
+    void *user;
+    size_t rx_len;
+    uint8_t rx[MQTT_LITE_RX_MAX];
+};
+
+// Opens the TCP connection and sends CONNECT; connected turns true once
+// the CONNACK has been read. Returns 0 or -errno.
+int mqtt_lite_connect(mqtt_lite_t *c, const char *host, int port,
+                      const char *client_id, int keepalive_s);
+void mqtt_lite_close(mqtt_lite_t *c);
+
+int mqtt_lite_subscribe(mqtt_lite_t *c, const char *topic, int qos);
+int mqtt_lite_publish(mqtt_lite_t *c, const char *topic, const void *payload,
+                      size_t len, int qos);
+int mqtt_lite_ping(mqtt_lite_t *c);
+
+// Drain the socket and dispatch complete packets. Returns -1 once the
+// connection is gone.
+int mqtt_lite_read(mqtt_lite_t *c);
+
+#endif
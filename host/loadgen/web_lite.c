@@ -0,0 +1,239 @@
+#define _GNU_SOURCE  // memmem
+
+#include "web_lite.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static int tcp_connect(const char *host, int port){
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *res;
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    if (getaddrinfo(host, port_str, &hints, &res) != 0) {
+        return -EHOSTUNREACH;
+    }
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) < 0) {
+        int err = errno;
+        if (fd >= 0) close(fd);
+        freeaddrinfo(res);
+        return -err;
+    }
+    freeaddrinfo(res);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static int write_all(int fd, const void *buf, size_t len){
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n > 0) {
+            p += n;
+            len -= (size_t)n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+            poll(&pfd, 1, 1000);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return -errno;
+        }
+    }
+    return 0;
+}
+
+// One request per connection (Connection: close), read until EOF.
+static int http_request(const char *host, int port, const char *req, size_t req_len,
+                        char *resp, size_t resp_size){
+    int fd = tcp_connect(host, port);
+    if (fd < 0) {
+        return fd;
+    }
+    int ret = write_all(fd, req, req_len);
+    if (ret < 0) {
+        close(fd);
+        return ret;
+    }
+
+    char buf[8192];
+    size_t len = 0;
+    ssize_t n;
+    while (len < sizeof(buf) - 1 && (n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0)) > 0) {
+        len += (size_t)n;
+    }
+    close(fd);
+    buf[len] = '\0';
+
+    int status = 0;
+    if (sscanf(buf, "HTTP/1.%*d %d", &status) != 1) {
+        return -EPROTO;
+    }
+    const char *body = strstr(buf, "\r\n\r\n");
+    if (resp && resp_size > 0) {
+        snprintf(resp, resp_size, "%s", body ? body + 4 : "");
+    }
+    return status;
+}
+
+int web_post_json(const char *host, int port, const char *path,
+                  const char *json, char *resp, size_t resp_size){
+    char req[4096];
+    int len = snprintf(req, sizeof(req),
+        "POST %s HTTP/1.1\r\nHost: %s:%d\r\nContent-Type: application/json\r\n"
+        "Content-Length: %zu\r\nConnection: close\r\n\r\n%s",
+        path, host, port, strlen(json), json);
+    if (len < 0 || (size_t)len >= sizeof(req)) {
+        return -EMSGSIZE;
+    }
+    return http_request(host, port, req, (size_t)len, resp, resp_size);
+}
+
+int web_get(const char *host, int port, const char *path, char *resp, size_t resp_size){
+    char req[512];
+    int len = snprintf(req, sizeof(req),
+        "GET %s HTTP/1.1\r\nHost: %s:%d\r\nConnection: close\r\n\r\n", path, host, port);
+    if (len < 0 || (size_t)len >= sizeof(req)) {
+        return -EMSGSIZE;
+    }
+    return http_request(host, port, req, (size_t)len, resp, resp_size);
+}
+
+int web_ws_connect(web_ws_t *ws, const char *host, int port, const char *path){
+    int fd = tcp_connect(host, port);
+    if (fd < 0) {
+        return fd;
+    }
+    // The key only has to be 16 bytes in base64 (this is the RFC 6455
+    // sample); the accept value is not checked, the server is ours.
+    char req[512];
+    int len = snprintf(req, sizeof(req),
+        "GET %s HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n",
+        path, host, port);
+    int ret = write_all(fd, req, (size_t)len);
+    if (ret < 0) {
+        close(fd);
+        return ret;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    if (ws->rx == NULL && (ws->rx = malloc(WEB_WS_RX_MAX)) == NULL) {
+        close(fd);
+        return -ENOMEM;
+    }
+    ws->fd = fd;
+    ws->open = false;
+    ws->rx_len = 0;
+    return 0;
+}
+
+// Client frames must be masked; a zero mask keeps the payload as is.
+static int ws_send_frame(web_ws_t *ws, uint8_t opcode, const void *data, size_t len){
+    uint8_t hdr[14];
+    size_t n = 0;
+    hdr[n++] = 0x80 | opcode;
+    if (len < 126) {
+        hdr[n++] = 0x80 | (uint8_t)len;
+    } else if (len <= 0xFFFF) {
+        hdr[n++] = 0x80 | 126;
+        hdr[n++] = (uint8_t)(len >> 8);
+        hdr[n++] = (uint8_t)len;
+    } else {
+        return -EMSGSIZE;
+    }
+    memset(hdr + n, 0, 4);
+    n += 4;
+    int ret = write_all(ws->fd, hdr, n);
+    return ret < 0 ? ret : write_all(ws->fd, data, len);
+}
+
+int web_ws_send_text(web_ws_t *ws, const char *text, size_t len){
+    return ws_send_frame(ws, 0x1, text, len);
+}
+
+// Returns bytes consumed, 0 if the frame is not complete yet.
+static size_t ws_parse_frame(web_ws_t *ws, const uint8_t *p, size_t avail){
+    if (avail < 2) return 0;
+    uint8_t opcode = p[0] & 0x0F;
+    bool masked = p[1] & 0x80;
+    uint64_t len = p[1] & 0x7F;
+    size_t hdr = 2;
+    if (len == 126) {
+        if (avail < 4) return 0;
+        len = ((uint64_t)p[2] << 8) | p[3];
+        hdr = 4;
+    } else if (len == 127) {
+        if (avail < 10) return 0;
+        len = 0;
+        for (int i = 0; i < 8; i++) len = (len << 8) | p[2 + i];
+        hdr = 10;
+    }
+    if (masked) hdr += 4;  // servers do not mask, but skip it if one does
+    if (avail < hdr + len) return 0;
+
+    const uint8_t *payload = p + hdr;
+    switch (opcode) {
+        case 0x1:  // text (our server never fragments)
+            if (ws->on_text) ws->on_text(ws, (const char *)payload, (size_t)len);
+            break;
+        case 0x9:  // ping
+            ws_send_frame(ws, 0xA, payload, (size_t)len);
+            break;
+        default:
+            break;
+    }
+    return hdr + (size_t)len;
+}
+
+int web_ws_read(web_ws_t *ws){
+    while (1) {
+        ssize_t n = recv(ws->fd, ws->rx + ws->rx_len, WEB_WS_RX_MAX - ws->rx_len, 0);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        ws->rx_len += (size_t)n;
+
+        size_t pos = 0;
+        if (!ws->open) {
+            char *end = memmem(ws->rx, ws->rx_len, "\r\n\r\n", 4);
+            if (end == NULL) continue;
+            if (strncmp(ws->rx, "HTTP/1.1 101", 12) != 0) return -1;
+            ws->open = true;
+            pos = (size_t)(end + 4 - ws->rx);
+        }
+
+        size_t used;
+        while ((used = ws_parse_frame(ws, (const uint8_t *)ws->rx + pos, ws->rx_len - pos)) > 0) {
+            pos += used;
+        }
+        if (pos == 0 && ws->rx_len == WEB_WS_RX_MAX) {
+            return -1;  // frame larger than the buffer
+        }
+        memmove(ws->rx, ws->rx + pos, ws->rx_len - pos);
+        ws->rx_len -= pos;
+    }
+}
+
+void web_ws_close(web_ws_t *ws){
+    if (ws->fd >= 0) close(ws->fd);
+    ws->fd = -1;
+    ws->open = false;
+    free(ws->rx);
+    ws->rx = NULL;
+}
@@ -0,0 +1,37 @@
+#ifndef WEB_LITE_H
+#define WEB_LITE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Plain HTTP/1.1 and WebSocket client bits the load generator needs to
+// talk to webapp/server.js like the dashboard does. No TLS, no redirects.
+
+// POST a JSON body, blocking. The response body (NUL terminated, cut to
+// size) goes to resp. Returns the HTTP status or -errno.
+int web_post_json(const char *host, int port, const char *path,
+                  const char *json, char *resp, size_t resp_size);
+int web_get(const char *host, int port, const char *path, char *resp, size_t resp_size);
+
+#define WEB_WS_RX_MAX (256 * 1024)
+
+typedef struct web_ws web_ws_t;
+typedef void (*web_ws_text_cb_t)(web_ws_t *ws, const char *text, size_t len);
+
+struct web_ws {
+    int fd;
+    bool open;               // handshake done
+    web_ws_text_cb_t on_text;
+    void *user;
+    size_t rx_len;
+    char *rx;                // WEB_WS_RX_MAX bytes
+};
+
+// Connect and send the upgrade request; frames are read with
+// web_ws_read() once the socket is readable (non-blocking).
+int web_ws_connect(web_ws_t *ws, const char *host, int port, const char *path);
+int web_ws_send_text(web_ws_t *ws, const char *text, size_t len);
+int web_ws_read(web_ws_t *ws);
+void web_ws_close(web_ws_t *ws);
+
+#endif
@@ -0,0 +1,426 @@
+// Host-side display simulator.
+//
+// Runs the firmware's rendering stack (MAX7219.c drawing, marquee.c scroller)
+// against a virtual MAX7219 chain and dumps what the sign would show, as PPM
+// images, ANSI terminal art, or golden frame files for regression checks.
+//
+//   display_sim --scene marquee --text "HELLO LPU!" --frames 120 --ansi
+//   display_sim --scene all --frames 300 --record sim/golden/all.txt
+//   display_sim --scene all --frames 300 --check  sim/golden/all.txt
+//
+// Simulated time is deterministic: every frame is one marquee step (80 ms,
+// the firmware's scroll period) and the clock ticks once per 1000 ms.
+// After each commit the register scrubber gets the same bus share it gets
+// on the device; --upset shows how fast it repairs a module hit by EMI.
+// With --gray every frame is one full cycle of the bit-plane scheduler,
+// averaged the way the eye sees it, and the free-running marquee is drawn
+// the way the firmware's message zone draws it in grayscale, caught half
+// way between two columns.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "MAX7219/MAX7219.h"
+#include "marquee/marquee.h"
+#include "font/font.h"
+#include "font_file.h"
+#include "display/display.h"
+#include "sim_chain.h"
+#include "sim_output.h"
+
+#define SIM_FRAME_MS 80
+#define SIM_SCRUB_BUDGET_BYTES \
+    ((uint32_t)((uint64_t)MAX7219_SPI_HZ / 8 * SIM_FRAME_MS / 1000 * DISPLAY_SCRUB_PERMILLE / 1000))
+
+typedef enum {
+    SCENE_BOOT,
+    SCENE_MARQUEE,
+    SCENE_CLOCK,
+    SCENE_WEATHER,
+    SCENE_ALL,
+    SCENE_GRAY,
+} scene_t;
+
+static const char *scene_names[] = {"boot", "marquee", "clock", "weather", "all", "gray"};
+
+typedef struct {
+    scene_t scene;
+    const char *text;
+    int frames;
+    int hr, min, sec;
+    int temp, wind;
+    int intensity;
+    const char *font;
+    int modules_per_line;
+    const char *ppm_dir;
+    int scale;
+    bool ansi;
+    int delay_ms;
+    const char *record;
+    const char *check;
+    int upset_frame;  // -1: never
+    int upset_module;
+    int wall;         // -1: free running marquee
+    int gray_bits;    // 0: plain on/off frames
+} sim_opts_t;
+
+typedef struct {
+    marquee_t mq;
+    int ms;         // simulated time since scene start
+    int clock_s;    // seconds since midnight shown on the clock
+} sim_state_t;
+
+static void usage(const char *argv0){
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --scene NAME      boot | marquee | clock | weather | all | gray\n"
+        "                    (default all; gray is a level ramp over the marquee)\n"
+        "  --text STR        marquee text (default firmware default message)\n"
+        "  --frames N        frames to render (default 100)\n"
+        "  --time HH:MM:SS   clock start time (default 12:34:56)\n"
+        "  --temp N          weather temperature (default 27)\n"
+        "  --wind N          weather wind speed (default 12)\n"
+        "  --intensity N     brightness 0..15 (default 15)\n"
+        "  --font FILE       CPF1 font blob, 'none' for the built-in A-Z table\n"
+        "  --layout L        grid (3 x 4 modules, default) | strip (12 x 1)\n"
+        "  --ppm DIR         write DIR/frame_NNNN.ppm\n"
+        "  --scale N         PPM pixels per LED (default 8)\n"
+        "  --ansi            print frames as ANSI art\n"
+        "  --delay MS        animate ANSI output in place, MS per frame\n"
+        "  --record FILE     write frames to a golden file\n"
+        "  --check FILE      compare frames against a golden file\n"
+        "  --upset F[:M]     corrupt module M (default 9) before frame F\n"
+        "  --wall COLS       scroll as the sign COLS columns left of the wall's\n"
+        "                    right end, position derived from the frame number\n"
+        "  --gray BITS       grayscale with 2 or 3 bit-planes (default off)\n",
+        argv0);
+}
+
+static int parse_scene(const char *name){
+    for (size_t i = 0; i < sizeof(scene_names) / sizeof(scene_names[0]); i++) {
+        if (strcmp(name, scene_names[i]) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void clock_draw(int clock_s){
+    draw_time(clock_s / 3600 % 24, clock_s / 60 % 60, clock_s % 60);
+}
+
+// 32 columns from off to full, moving one column per frame
+static void gray_ramp_draw(int frame){
+    uint8_t levels[4 * 64];
+    for (int m = 0; m < 4; m++) {
+        for (int row = 0; row < 8; row++) {
+            for (int col = 0; col < 8; col++) {
+                int x = (m * 8 + col + frame) % 32;
+                levels[(m * 8 + row) * 8 + col] = (uint8_t)(x * 255 / 31);
+            }
+        }
+    }
+    draw_zone_levels(8, 4, levels);
+}
+
+// One cycle of the plane scheduler (main/gray): every plane latched in
+// turn and weighted 2^b, scaled back to the 1..16 steps of a snapshot.
+static void gray_snapshot(sim_frame_t *frame, int modules_per_line, int bits){
+    static uint16_t acc[SIM_MAX_PIXELS];
+    const int full = (1 << bits) - 1;
+
+    memset(acc, 0, sizeof(acc));
+    for (int plane = 0; plane < bits; plane++) {
+        max7219_gray_show(plane);
+        sim_chain_snapshot(frame, modules_per_line);
+        for (int i = 0; i < frame->width * frame->height; i++) {
+            acc[i] += frame->px[i] << plane;
+        }
+    }
+    for (int i = 0; i < frame->width * frame->height; i++) {
+        int level = (acc[i] + full / 2) / full;
+        frame->px[i] = (uint8_t)(acc[i] && level == 0 ? 1 : level);
+    }
+}
+
+static void scene_start(const sim_opts_t *o, sim_state_t *st){
+    init_spi();
+    set_all_brightness((uint8_t)o->intensity);
+    max7219_gray_begin(o->gray_bits);
+    marquee_init(&st->mq, o->text, strlen(o->text));
+    st->ms = 0;
+    st->clock_s = o->hr * 3600 + o->min * 60 + o->sec;
+
+    weather_data_t weather = {.temp = o->temp, .wind_speed = o->wind};
+    switch (o->scene) {
+        case SCENE_BOOT:
+            draw_init();
+            break;
+        case SCENE_WEATHER:
+            draw_weather(weather);
+            break;
+        case SCENE_ALL:
+            // same order as engine_task: boot screen, then the zones take over
+            draw_init();
+            draw_weather(weather);
+            clock_draw(st->clock_s);
+            break;
+        case SCENE_GRAY:
+            clock_draw(st->clock_s);
+            break;
+        default:
+            break;
+    }
+    max7219_commit();
+}
+
+// The firmware's synced scroll (scroll_sync.h) with one frame per column
+static void marquee_advance(const sim_opts_t *o, sim_state_t *st, int frame){
+    if (o->wall < 0) {
+        marquee_step(&st->mq);
+    } else {
+        marquee_seek(&st->mq, (int64_t)frame - o->wall);
+    }
+}
+
+static void marquee_draw(const sim_opts_t *o, sim_state_t *st){
+    if (o->gray_bits && o->wall < 0) {
+        uint8_t next[MARQUEE_BUF_LEN];
+        uint8_t levels[MARQUEE_BUF_LEN * 8];
+        marquee_peek(&st->mq, next);
+        marquee_levels(st->mq.buf, next, MARQUEE_SUBSTEPS / 2, levels);
+        draw_zone_levels(8, 4, levels);
+    } else {
+        draw_buffer(st->mq.buf);
+    }
+}
+
+static void scene_step(const sim_opts_t *o, sim_state_t *st, int frame){
+    switch (o->scene) {
+        case SCENE_MARQUEE:
+            marquee_advance(o, st, frame);
+            marquee_draw(o, st);
+            break;
+        case SCENE_CLOCK:
+            if (frame > 0) st->clock_s++;
+            clock_draw(st->clock_s);
+            break;
+        case SCENE_ALL:
+            marquee_advance(o, st, frame);
+            marquee_draw(o, st);
+            st->ms += SIM_FRAME_MS;
+            if (st->ms >= 1000) {
+                st->ms -= 1000;
+                st->clock_s++;
+                clock_draw(st->clock_s);
+            }
+            break;
+        case SCENE_GRAY:
+            gray_ramp_draw(frame);
+            break;
+        default:
+            break;
+    }
+    // one commit per frame, as the firmware display task does
+    max7219_commit();
+    max7219_scrub(SIM_SCRUB_BUDGET_BYTES);
+}
+
+int main(int argc, char **argv){
+    sim_opts_t o = {
+        .scene = SCENE_ALL,
+        .text = "HELLO LPU! WE ARE CIRCUIT CRAFTERS.",
+        .frames = 100,
+        .hr = 12, .min = 34, .sec = 56,
+        .temp = 27, .wind = 12,
+        .intensity = 15,
+#ifdef HOST_FONT_PATH
+        .font = HOST_FONT_PATH,
+#endif
+        .modules_per_line = 4,
+        .scale = 8,
+        .upset_frame = -1,
+        .upset_module = 9,
+        .wall = -1,
+    };
+
+    static const struct option long_opts[] = {
+        {"scene",     required_argument, NULL, 's'},
+        {"text",      required_argument, NULL, 'x'},
+        {"frames",    required_argument, NULL, 'n'},
+        {"time",      required_argument, NULL, 't'},
+        {"temp",      required_argument, NULL, 'T'},
+        {"wind",      required_argument, NULL, 'w'},
+        {"intensity", required_argument, NULL, 'i'},
+        {"font",      required_argument, NULL, 'f'},
+        {"layout",    required_argument, NULL, 'l'},
+        {"ppm",       required_argument, NULL, 'p'},
+        {"scale",     required_argument, NULL, 'S'},
+        {"ansi",      no_argument,       NULL, 'a'},
+        {"delay",     required_argument, NULL, 'd'},
+        {"record",    required_argument, NULL, 'r'},
+        {"check",     required_argument, NULL, 'c'},
+        {"upset",     required_argument, NULL, 'u'},
+        {"wall",      required_argument, NULL, 'W'},
+        {"gray",      required_argument, NULL, 'g'},
+        {"help",      no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 's': {
+                int s = parse_scene(optarg);
+                if (s < 0) {
+                    fprintf(stderr, "unknown scene '%s'\n", optarg);
+                    return 2;
+                }
+                o.scene = (scene_t)s;
+                break;
+            }
+            case 'x': o.text = optarg; break;
+            case 'n': o.frames = atoi(optarg); break;
+            case 't':
+                if (sscanf(optarg, "%d:%d:%d", &o.hr, &o.min, &o.sec) != 3) {
+                    fprintf(stderr, "bad --time '%s'\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'T': o.temp = atoi(optarg); break;
+            case 'w': o.wind = atoi(optarg); break;
+            case 'i': o.intensity = atoi(optarg); break;
+            case 'f': o.font = strcmp(optarg, "none") == 0 ? NULL : optarg; break;
+            case 'l':
+                if (strcmp(optarg, "grid") == 0) o.modules_per_line = 4;
+                else if (strcmp(optarg, "strip") == 0) o.modules_per_line = NUM_MODULES;
+                else {
+                    fprintf(stderr, "unknown layout '%s'\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'p': o.ppm_dir = optarg; break;
+            case 'S': o.scale = atoi(optarg); break;
+            case 'a': o.ansi = true; break;
+            case 'd': o.delay_ms = atoi(optarg); break;
+            case 'r': o.record = optarg; break;
+            case 'c': o.check = optarg; break;
+            case 'W': o.wall = atoi(optarg); break;
+            case 'g':
+                o.gray_bits = atoi(optarg);
+                if (o.gray_bits != 0 && (o.gray_bits < 2 || o.gray_bits > MAX7219_GRAY_BITS_MAX)) {
+                    fprintf(stderr, "--gray takes 2..%d bit-planes\n", MAX7219_GRAY_BITS_MAX);
+                    return 2;
+                }
+                break;
+            case 'u':
+                if (sscanf(optarg, "%d:%d", &o.upset_frame, &o.upset_module) < 1 ||
+                    o.upset_module < 0 || o.upset_module >= NUM_MODULES) {
+                    fprintf(stderr, "bad --upset '%s'\n", optarg);
+                    return 2;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (o.font) {
+        esp_err_t ret = font_load_file(o.font);
+        if (ret != ESP_OK) {
+            fprintf(stderr, "%s: not a usable font (0x%x)\n", o.font, ret);
+            return 2;
+        }
+    }
+
+    FILE *record = NULL;
+    FILE *check = NULL;
+    if (o.record && !(record = fopen(o.record, "w"))) {
+        perror(o.record);
+        return 2;
+    }
+    if (o.check && !(check = fopen(o.check, "r"))) {
+        perror(o.check);
+        return 2;
+    }
+    if (o.ppm_dir) {
+        mkdir(o.ppm_dir, 0755);
+    }
+
+    static sim_state_t st;
+    static sim_frame_t frame, golden;
+    int failures = 0;
+
+    scene_start(&o, &st);
+    if (o.ansi && o.delay_ms > 0) {
+        fputs("\x1b[2J", stdout);
+    }
+
+    for (int i = 0; i < o.frames; i++) {
+        if (i == o.upset_frame) {
+            sim_chain_upset(o.upset_module);
+        }
+        scene_step(&o, &st, i);
+        if (o.gray_bits) {
+            gray_snapshot(&frame, o.modules_per_line, o.gray_bits);
+        } else {
+            sim_chain_snapshot(&frame, o.modules_per_line);
+        }
+
+        if (record) {
+            if (i == 0) {
+                char desc[160];
+                snprintf(desc, sizeof(desc), "scene=%s frames=%d", scene_names[o.scene], o.frames);
+                sim_golden_write_header(record, &frame, desc);
+            }
+            sim_golden_write(record, i, &frame);
+        }
+        if (check) {
+            int rc = sim_golden_read(check, &golden);
+            if (rc <= 0) {
+                fprintf(stderr, "%s: %s at frame %d\n", o.check,
+                        rc == 0 ? "ran out of frames" : "malformed", i);
+                failures++;
+                break;
+            }
+            int at = sim_frame_diff(&frame, &golden);
+            if (at >= 0 && failures++ < 10) {
+                fprintf(stderr, "frame %d differs from %s at (%d,%d)\n",
+                        i, o.check, at % frame.width, at / frame.width);
+            }
+        }
+        if (o.ppm_dir) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/frame_%04d.ppm", o.ppm_dir, i);
+            if (sim_write_ppm(path, &frame, o.scale) != 0) {
+                perror(path);
+                return 2;
+            }
+        }
+        if (o.ansi) {
+            sim_print_ansi(stdout, &frame, o.delay_ms > 0);
+            if (o.delay_ms > 0) {
+                fflush(stdout);
+                usleep((useconds_t)o.delay_ms * 1000);
+            } else {
+                fputc('\n', stdout);
+            }
+        }
+    }
+
+    if (record) fclose(record);
+    if (check) {
+        fclose(check);
+        if (failures) {
+            fprintf(stderr, "%d frame(s) differ from %s\n", failures, o.check);
+            return 1;
+        }
+        printf("%d frames match %s\n", o.frames, o.check);
+    }
+    return 0;
+}
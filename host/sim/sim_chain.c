@@ -0,0 +1,93 @@
+#include "sim_chain.h"
+#include "MAX7219/MAX7219_port.h"
+#include <string.h>
+
+sim_module_t sim_chain[NUM_MODULES];
+sim_stats_t sim_stats;
+
+void sim_chain_reset(void){
+    memset(sim_chain, 0, sizeof(sim_chain));
+    memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+esp_err_t max7219_port_init(void){
+    sim_chain_reset();
+    return ESP_OK;
+}
+
+void sim_chain_upset(int module){
+    sim_module_t *m = &sim_chain[module];
+    m->test = 1;
+    m->scan_limit = 0x02;
+    for (int row = 0; row < 8; row++) {
+        m->digit[row] ^= (uint8_t)(0x81 >> (row & 3));
+    }
+}
+
+// Single threaded, nothing to serialize.
+void max7219_port_lock(void){}
+void max7219_port_unlock(void){}
+
+static void sim_module_latch(sim_module_t *m, uint8_t reg, uint8_t data){
+    reg &= 0x0F; // D15..D12 are don't care
+    if (reg >= 0x01 && reg <= 0x08) {
+        m->digit[reg - 1] = data;
+        return;
+    }
+    switch (reg) {
+        case 0x09: m->decode = data; break;
+        case 0x0A: m->intensity = data & 0x0F; break;
+        case 0x0B: m->scan_limit = data & 0x07; break;
+        case 0x0C: m->shutdown = data & 0x01; break;
+        case 0x0F: m->test = data & 0x01; break;
+        default: return; // 0x00 NO-OP
+    }
+}
+
+void max7219_port_write(const uint8_t *buf, size_t len){
+    sim_stats.writes++;
+    sim_stats.bytes += len;
+
+    // The driver addresses module i through bytes [2i, 2i + 1]; frames
+    // shorter than the chain leave the remaining modules untouched.
+    for (size_t i = 0; i < NUM_MODULES && (i * 2 + 1) < len; i++) {
+        uint8_t reg = buf[i * 2];
+        if ((reg & 0x0F) != 0x00) {
+            sim_stats.reg_writes++;
+        }
+        sim_module_latch(&sim_chain[i], reg, buf[i * 2 + 1]);
+    }
+}
+
+void sim_chain_snapshot(sim_frame_t *frame, int modules_per_line){
+    if (modules_per_line <= 0 || modules_per_line > NUM_MODULES) {
+        modules_per_line = NUM_MODULES;
+    }
+    int lines = (NUM_MODULES + modules_per_line - 1) / modules_per_line;
+    frame->width = modules_per_line * 8;
+    frame->height = lines * 8;
+    memset(frame->px, 0, sizeof(frame->px));
+
+    for (int module = 0; module < NUM_MODULES; module++) {
+        const sim_module_t *m = &sim_chain[module];
+        int x0 = (module % modules_per_line) * 8;
+        int y0 = (module / modules_per_line) * 8;
+        for (int row = 0; row < 8; row++) {
+            uint8_t bits;
+            if (m->test) {
+                bits = 0xFF;            // display test overrides shutdown
+            } else if (!m->shutdown || row > m->scan_limit) {
+                bits = 0x00;
+            } else {
+                bits = m->digit[row];
+            }
+            for (int col = 0; col < 8; col++) {
+                // bit 7 is the left-most LED of a row
+                if (bits & (0x80 >> col)) {
+                    uint8_t level = m->test ? 16 : (uint8_t)(m->intensity + 1);
+                    frame->px[(y0 + row) * frame->width + x0 + col] = level;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef SIM_CHAIN_H
+#define SIM_CHAIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "MAX7219/MAX7219.h"
+
+// Register-level model of the NUM_MODULES MAX7219 chain. The simulator's
+// max7219_port_write() decodes every chain frame into this model exactly
+// like the real modules latch it on CS high.
+typedef struct {
+    uint8_t digit[8];    // 0x01..0x08
+    uint8_t decode;      // 0x09
+    uint8_t intensity;   // 0x0A
+    uint8_t scan_limit;  // 0x0B
+    uint8_t shutdown;    // 0x0C, 0 = shutdown, 1 = normal operation
+    uint8_t test;        // 0x0F
+} sim_module_t;
+
+typedef struct {
+    uint32_t writes;     // chain transactions (CS low/high pairs)
+    uint32_t bytes;      // bytes shifted out
+    uint32_t reg_writes; // non NO-OP register writes
+} sim_stats_t;
+
+extern sim_module_t sim_chain[NUM_MODULES];
+extern sim_stats_t sim_stats;
+
+// Power-on state: every module in shutdown, like the real part.
+void sim_chain_reset(void);
+
+// What an EMI hit does to a module: test mode on, scan limit cut short
+// and a few digit bits flipped. Only the scrubber brings it back.
+void sim_chain_upset(int module);
+
+// Frame as seen from the front of the sign. modules_per_line = 4 gives the
+// 3 x 4 module plate (32x24), 12 gives a single 96x8 strip.
+#define SIM_MAX_PIXELS (NUM_MODULES * 64)
+
+typedef struct {
+    int width;
+    int height;
+    uint8_t px[SIM_MAX_PIXELS]; // 0 = off, 1..16 = on at intensity + 1
+} sim_frame_t;
+
+void sim_chain_snapshot(sim_frame_t *frame, int modules_per_line);
+
+static inline uint8_t sim_frame_get(const sim_frame_t *frame, int x, int y){
+    return frame->px[y * frame->width + x];
+}
+
+#endif
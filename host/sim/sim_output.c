@@ -0,0 +1,134 @@
+#include "sim_output.h"
+#include <string.h>
+
+static void led_rgb(uint8_t level, uint8_t rgb[3]){
+    if (level == 0) {
+        rgb[0] = 0x30; rgb[1] = 0x08; rgb[2] = 0x08; // unlit LED
+        return;
+    }
+    // MAX7219 duty cycle is linear in the intensity register
+    rgb[0] = (uint8_t)(0x60 + (level * (0xFF - 0x60)) / 16);
+    rgb[1] = (uint8_t)(level * 0x30 / 16);
+    rgb[2] = (uint8_t)(level * 0x10 / 16);
+}
+
+int sim_write_ppm(const char *path, const sim_frame_t *frame, int scale){
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    if (scale < 1) scale = 1;
+    int w = frame->width * scale;
+    int h = frame->height * scale;
+    fprintf(f, "P6\n%d %d\n255\n", w, h);
+
+    static const uint8_t gap[3] = {0x00, 0x00, 0x00};
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint8_t rgb[3];
+            // leave a one pixel dark border around each LED once it is big enough
+            bool border = scale >= 4 && ((x % scale) == scale - 1 || (y % scale) == scale - 1);
+            if (border) {
+                fwrite(gap, 1, 3, f);
+                continue;
+            }
+            led_rgb(sim_frame_get(frame, x / scale, y / scale), rgb);
+            fwrite(rgb, 1, 3, f);
+        }
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+void sim_print_ansi(FILE *out, const sim_frame_t *frame, bool home){
+    if (home) {
+        fputs("\x1b[H", out);
+    }
+    for (int y = 0; y < frame->height; y++) {
+        for (int x = 0; x < frame->width; x++) {
+            uint8_t rgb[3];
+            uint8_t level = sim_frame_get(frame, x, y);
+            led_rgb(level, rgb);
+            fprintf(out, "\x1b[38;2;%d;%d;%dm%s", rgb[0], rgb[1], rgb[2], level ? "██" : "· ");
+        }
+        fputs("\x1b[0m\n", out);
+    }
+}
+
+void sim_golden_write_header(FILE *out, const sim_frame_t *frame, const char *desc){
+    fprintf(out, "# display_sim golden: %s\n", desc);
+    fprintf(out, "size %dx%d\n", frame->width, frame->height);
+}
+
+void sim_golden_write(FILE *out, int index, const sim_frame_t *frame){
+    static const char hex[] = "0123456789abcdef";
+    fprintf(out, "frame %d\n", index);
+    for (int y = 0; y < frame->height; y++) {
+        for (int x = 0; x < frame->width; x++) {
+            uint8_t level = sim_frame_get(frame, x, y);
+            fputc(level ? hex[(level - 1) & 0x0F] : '.', out);
+        }
+        fputc('\n', out);
+    }
+}
+
+static int golden_level(char c){
+    if (c == '.') return 0;
+    if (c >= '0' && c <= '9') return c - '0' + 1;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 11;
+    return -1;
+}
+
+int sim_golden_read(FILE *in, sim_frame_t *frame){
+    char line[512];
+    int index;
+
+    // header lines may appear before any frame
+    while (1) {
+        if (!fgets(line, sizeof(line), in)) {
+            return 0;
+        }
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "size %dx%d", &frame->width, &frame->height) == 2) {
+            if (frame->width <= 0 || frame->height <= 0 ||
+                frame->width * frame->height > SIM_MAX_PIXELS) {
+                return -1;
+            }
+            continue;
+        }
+        if (sscanf(line, "frame %d", &index) == 1) {
+            break;
+        }
+        return -1;
+    }
+    if (frame->width <= 0 || frame->height <= 0) {
+        return -1;
+    }
+
+    for (int y = 0; y < frame->height; y++) {
+        if (!fgets(line, sizeof(line), in) || (int)strcspn(line, "\r\n") != frame->width) {
+            return -1;
+        }
+        for (int x = 0; x < frame->width; x++) {
+            int level = golden_level(line[x]);
+            if (level < 0) {
+                return -1;
+            }
+            frame->px[y * frame->width + x] = (uint8_t)level;
+        }
+    }
+    return 1;
+}
+
+int sim_frame_diff(const sim_frame_t *a, const sim_frame_t *b){
+    if (a->width != b->width || a->height != b->height) {
+        return 0;
+    }
+    for (int i = 0; i < a->width * a->height; i++) {
+        if (a->px[i] != b->px[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,30 @@
+#ifndef SIM_OUTPUT_H
+#define SIM_OUTPUT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "sim_chain.h"
+
+// Binary PPM (P6), every LED drawn as a scale x scale dot.
+int sim_write_ppm(const char *path, const sim_frame_t *frame, int scale);
+
+// 24-bit ANSI colour art, two terminal cells per LED. With home set the
+// cursor is moved back to the top left first so frames animate in place.
+void sim_print_ansi(FILE *out, const sim_frame_t *frame, bool home);
+
+// Golden frame files are plain text so they diff well in review:
+//
+//   size 32x24
+//   frame 0
+//   ....f.f.....                 one line per LED row
+//
+// '.' is an unlit LED, '0'..'f' a lit one at that intensity.
+void sim_golden_write_header(FILE *out, const sim_frame_t *frame, const char *desc);
+void sim_golden_write(FILE *out, int index, const sim_frame_t *frame);
+// 1 = frame read, 0 = end of file, -1 = malformed file
+int sim_golden_read(FILE *in, sim_frame_t *frame);
+
+// Index of the first differing pixel, -1 when equal.
+int sim_frame_diff(const sim_frame_t *a, const sim_frame_t *b);
+
+#endif
@@ -1,18 +1,10 @@
 #include "MAX7219.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "esp_log.h"
-#include "driver/spi_master.h"
-#include "driver/gpio.h"
+#include "MAX7219_port.h"
+#include "../trace/trace.h"
 #include "esp_err.h"
-#include "soc/soc_caps.h"
+#include <stdbool.h>
 #include <string.h>
 
-#define NUM_MODULES 12  
-
-#define CS_LOW()  gpio_set_level(CS_PIN, 0)
-#define CS_HIGH() gpio_set_level(CS_PIN, 1)
-
 
 const weather_time_font7x3_t weather_time_font7x3[] = {
      [0] = {{
@@ -483,21 +475,32 @@ const string_font6x5_t string_font6x5[] = {
     }}
 };
 
-spi_device_handle_t spi;
-
-// init CS pin
-static esp_err_t init_cs(){
-    gpio_config_t io_conf = {
-        .intr_type = GPIO_INTR_DISABLE,
-        .mode = GPIO_MODE_OUTPUT,
-        .pin_bit_mask = (1ULL << CS_PIN),
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-    };
-    ESP_ERROR_CHECK(gpio_config(&io_conf));
-    ESP_ERROR_CHECK(CS_HIGH());   // Deselect MAX7219
-    return ESP_OK;
-}
+// Frames are composed off-screen in back_fb by the draw_* functions and
+// only reach the modules through max7219_commit(), so a half drawn zone is
+// never latched and every zone changes on the same commit.
+static uint8_t back_fb[NUM_MODULES][8];
+static uint32_t commit_count;
+
+// What every module currently holds (the front buffer), so commits only
+// send changed rows, blank modules can be shut down and brightness changes
+// re-applied without reading anything back.
+static uint8_t shadow_digit[NUM_MODULES][8];
+static uint8_t shadow_on[NUM_MODULES];        // 0x0C as latched, 1 = normal operation
+static uint8_t requested_intensity[NUM_MODULES];
+static uint8_t intensity_cap = 0x0F;
+static bool auto_shutdown = true;
+static bool display_off = false;
+
+// Grayscale bit-planes, plane p weighing 2^p. draw_zone_levels() keeps
+// MAX7219_GRAY_BITS_MAX planes of its modules in gray_back; a commit
+// composes the active planes of the whole chain into gray_next, and the
+// plane scheduler copies that to gray_front at the start of a cycle.
+static int gray_bits;
+static bool gray_module[NUM_MODULES];   // gray_back holds this module
+static uint8_t gray_back[MAX7219_GRAY_BITS_MAX][NUM_MODULES][8];
+static uint8_t gray_next[MAX7219_GRAY_BITS_MAX][NUM_MODULES][8];
+static uint8_t gray_front[MAX7219_GRAY_BITS_MAX][NUM_MODULES][8];
+static bool gray_next_ready;
 
 // Send one register+data pair to ALL cascaded modules
 void max7219_send_all(uint8_t reg, uint8_t data)
@@ -509,15 +512,11 @@ void max7219_send_all(uint8_t reg, uint8_t data)
         buf[i*2 + 1] = data;
     }
 
-    spi_transaction_t t = {
-        .length = NUM_MODULES * 16,
-        .tx_buffer = buf
-    };
-
-    CS_LOW();
-    spi_device_polling_transmit(spi, &t);
-    CS_HIGH();
-    esp_rom_delay_us(2); // Small delay to ensure data is latched
+    max7219_port_lock();
+    TRACE_BEGIN(TRACE_SPI, reg);
+    max7219_port_write(buf, sizeof(buf));
+    TRACE_END(TRACE_SPI, reg);
+    max7219_port_unlock();
 }
 
 void max7219_send(int module, uint8_t reg, uint8_t data)
@@ -534,16 +533,36 @@ void max7219_send(int module, uint8_t reg, uint8_t data)
         }
     }
 
-    spi_transaction_t t = {
-        .length = NUM_MODULES * 16,
-        .tx_buffer = buf,
-        // .tx_length = 0
-    };
+    max7219_port_lock();
+    if (reg >= 0x01 && reg <= 0x08) {
+        shadow_digit[module][reg - 1] = data;
+        back_fb[module][reg - 1] = data;  // keep the next commit from undoing it
+    }
+    TRACE_BEGIN(TRACE_SPI, reg);
+    max7219_port_write(buf, sizeof(buf));
+    TRACE_END(TRACE_SPI, reg);
+    max7219_port_unlock();
+}
+
+// Different register+data per module in ONE chain transaction,
+// reg[i] == 0x00 leaves module i alone.
+void max7219_send_chain(const uint8_t reg[NUM_MODULES], const uint8_t data[NUM_MODULES])
+{
+    uint8_t buf[NUM_MODULES * 2];
+
+    max7219_port_lock();
+    for (int i = 0; i < NUM_MODULES; i++) {
+        buf[i*2 + 0] = reg[i];
+        buf[i*2 + 1] = reg[i] ? data[i] : 0x00;
+        if (reg[i] >= 0x01 && reg[i] <= 0x08) {
+            shadow_digit[i][reg[i] - 1] = data[i];
+        }
+    }
 
-    CS_LOW();
-    spi_device_polling_transmit(spi, &t);
-    CS_HIGH();
-    esp_rom_delay_us(2); // Small delay to ensure data is latched
+    TRACE_BEGIN(TRACE_SPI, buf[0]);
+    max7219_port_write(buf, sizeof(buf));
+    TRACE_END(TRACE_SPI, buf[0]);
+    max7219_port_unlock();
 }
 
 static void max7219_basic_init()
@@ -553,24 +572,278 @@ static void max7219_basic_init()
     max7219_send_all(0x0A, 0x0F);  // Brightness MAX
     max7219_send_all(0x0B, 0x07);  // Scan limit = 8 rows
     max7219_send_all(0x0F, 0x00);  // Test mode OFF
+
+    memset(back_fb, 0, sizeof(back_fb));
+    memset(shadow_digit, 0, sizeof(shadow_digit));
+    memset(shadow_on, 0x01, sizeof(shadow_on));
+    memset(requested_intensity, 0x0F, sizeof(requested_intensity));
+}
+
+static bool module_blank(int module){
+    if (gray_bits) {
+        // The latched rows are one plane; blank means blank in all of them
+        for (int plane = 0; plane < gray_bits; plane++) {
+            for (int row = 0; row < 8; row++) {
+                if (gray_next[plane][module][row]) return false;
+            }
+        }
+        return true;
+    }
+    for (int row = 0; row < 8; row++) {
+        if (shadow_digit[module][row]) return false;
+    }
+    return true;
+}
+
+// Bring the shutdown register of every module in line with its content
+// and the night-off state. Runs as the last step of every commit, so a
+// zone that is cleared and redrawn in one frame does not blink. Digit
+// registers keep their data in shutdown, so waking is instant.
+void max7219_power_sync(void)
+{
+    max7219_port_lock();
+    uint8_t reg[NUM_MODULES] = {0};
+    uint8_t data[NUM_MODULES] = {0};
+    bool changed = false;
+
+    for (int module = 0; module < NUM_MODULES; module++) {
+        uint8_t on = !display_off && !(auto_shutdown && module_blank(module));
+        if (on != shadow_on[module]) {
+            reg[module] = 0x0C;
+            data[module] = on;
+            shadow_on[module] = on;
+            changed = true;
+        }
+    }
+    if (changed) {
+        max7219_send_chain(reg, data);
+    }
+    max7219_port_unlock();
+}
+
+void max7219_set_auto_shutdown(bool enable)
+{
+    max7219_port_lock();
+    auto_shutdown = enable;
+    max7219_power_sync();
+    max7219_port_unlock();
+}
+
+void max7219_set_display_off(bool off)
+{
+    max7219_port_lock();
+    if (off != display_off) {
+        display_off = off;
+        max7219_power_sync();
+    }
+    max7219_port_unlock();
+}
+
+static uint8_t capped(uint8_t intensity)
+{
+    return intensity < intensity_cap ? intensity : intensity_cap;
+}
+
+void max7219_set_intensity_cap(uint8_t cap)
+{
+    if (cap > 0x0F) cap = 0x0F;
+    max7219_port_lock();
+    if (cap != intensity_cap) {
+        intensity_cap = cap;
+
+        uint8_t reg[NUM_MODULES];
+        uint8_t data[NUM_MODULES];
+        for (int module = 0; module < NUM_MODULES; module++) {
+            reg[module] = 0x0A;
+            data[module] = capped(requested_intensity[module]);
+        }
+        max7219_send_chain(reg, data);
+    }
+    max7219_port_unlock();
 }
 
 void max7219_set_brightness(uint8_t module, uint8_t intensity) {
     // intensity: 0x00 (min) to 0x0F (max)
     if (intensity > 0x0F) intensity = 0x0F;  // Clamp to max
-    max7219_send(module, 0x0A, intensity);
+    max7219_port_lock();
+    requested_intensity[module] = intensity;
+    max7219_send(module, 0x0A, capped(intensity));
+    max7219_port_unlock();
 }
 
 void set_all_brightness(uint8_t intensity) {
-    for (int module = 0; module < NUM_MODULES; module++){
-        max7219_set_brightness(module, intensity);
+    if (intensity > 0x0F) intensity = 0x0F;
+    max7219_port_lock();
+    memset(requested_intensity, intensity, sizeof(requested_intensity));
+    max7219_send_all(0x0A, capped(intensity));  // one transaction for the whole chain
+    max7219_port_unlock();
+}
+
+// The active planes of the back buffer, most significant ones of gray_back
+// for modules drawn with levels, the plain rows in every plane otherwise.
+static void gray_compose(void)
+{
+    int skip = MAX7219_GRAY_BITS_MAX - gray_bits;
+    for (int plane = 0; plane < gray_bits; plane++) {
+        for (int module = 0; module < NUM_MODULES; module++) {
+            memcpy(gray_next[plane][module],
+                   gray_module[module] ? gray_back[plane + skip][module] : back_fb[module], 8);
+        }
     }
+    gray_next_ready = true;
 }
 
-void drawClear(int module){
-    for (int row = 1; row <=8; row++){
-        max7219_send(module, row, 0x00);
+// One chain transaction per row that differs from what the modules hold
+// (modules whose row did not change get a NO-OP), so at most 8, back to
+// back. Returns the transactions sent.
+static int send_changed_rows(const uint8_t rows[NUM_MODULES][8])
+{
+    uint8_t reg[NUM_MODULES];
+    uint8_t data[NUM_MODULES] = {0};
+    int sent = 0;
+
+    for (int row = 0; row < 8; row++) {
+        bool changed = false;
+        for (int module = 0; module < NUM_MODULES; module++) {
+            if (rows[module][row] != shadow_digit[module][row]) {
+                reg[module] = row + 1;
+                data[module] = rows[module][row];
+                changed = true;
+            } else {
+                reg[module] = 0x00;
+            }
+        }
+        if (changed) {
+            max7219_send_chain(reg, data);
+            sent++;
+        }
+    }
+    return sent;
+}
+
+// Push the back buffer's changed rows, then the shutdown update. In
+// grayscale the planes go out from max7219_gray_show() instead.
+void max7219_commit(void)
+{
+    max7219_port_lock();
+    if (gray_bits) {
+        gray_compose();
+    } else {
+        send_changed_rows(back_fb);
     }
+    max7219_power_sync();
+    commit_count++;
+    max7219_port_unlock();
+}
+
+uint32_t max7219_commit_count(void)
+{
+    return commit_count;
+}
+
+void max7219_gray_begin(int bits)
+{
+    if (bits < 0) bits = 0;
+    if (bits > MAX7219_GRAY_BITS_MAX) bits = MAX7219_GRAY_BITS_MAX;
+    max7219_port_lock();
+    gray_bits = bits;
+    if (bits) {
+        // Start from the last committed frame, not from empty planes
+        gray_compose();
+        memcpy(gray_front, gray_next, sizeof(gray_front));
+        gray_next_ready = false;
+    }
+    // Leaving grayscale, the next commit sends back_fb over whichever
+    // plane is latched, like any other change
+    max7219_port_unlock();
+}
+
+int max7219_gray_bits(void)
+{
+    return gray_bits;
+}
+
+int max7219_gray_show(int plane)
+{
+    int sent = 0;
+
+    max7219_port_lock();
+    if (plane >= 0 && plane < gray_bits) {
+        if (plane == 0 && gray_next_ready) {
+            memcpy(gray_front, gray_next, sizeof(gray_front));
+            gray_next_ready = false;
+        }
+        sent = send_changed_rows(gray_front[plane]);
+    }
+    max7219_port_unlock();
+    return sent;
+}
+
+// Background scrubbing. EMI can flip a module into test mode, change its
+// scan limit or garble a digit register, and nothing but basic_init ever
+// wrote those. Each slice re-asserts one register on the whole chain
+// from the shadow state (one chain transaction), test mode first since it
+// masks everything else. Slices are paid for from a byte budget the
+// caller tops up every frame, so scrubbing never takes more than that
+// share of the bus.
+static const uint8_t scrub_regs[] = {
+    0x0F, 0x0B, 0x09, 0x0A, 0x0C,
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+};
+#define SCRUB_SLICE_BYTES (NUM_MODULES * 2)
+
+static int scrub_pos;
+static uint32_t scrub_credit;
+static uint32_t scrub_passes;
+
+static void max7219_scrub_slice(uint8_t r)
+{
+    uint8_t reg[NUM_MODULES];
+    uint8_t data[NUM_MODULES];
+
+    for (int module = 0; module < NUM_MODULES; module++) {
+        reg[module] = r;
+        switch (r) {
+            case 0x0F: data[module] = 0x00; break;  // Test mode OFF
+            case 0x0B: data[module] = 0x07; break;  // Scan limit = 8 rows
+            case 0x09: data[module] = 0x00; break;  // Decode OFF
+            case 0x0A: data[module] = capped(requested_intensity[module]); break;
+            case 0x0C: data[module] = shadow_on[module]; break;
+            default:   data[module] = shadow_digit[module][r - 1]; break;
+        }
+    }
+    max7219_send_chain(reg, data);
+}
+
+void max7219_scrub(uint32_t budget_bytes)
+{
+    max7219_port_lock();
+    scrub_credit += budget_bytes;
+    if (scrub_credit > 2 * SCRUB_SLICE_BYTES) {
+        scrub_credit = 2 * SCRUB_SLICE_BYTES;  // no bursts after idle time
+    }
+    while (scrub_credit >= SCRUB_SLICE_BYTES) {
+        scrub_credit -= SCRUB_SLICE_BYTES;
+        max7219_scrub_slice(scrub_regs[scrub_pos]);
+        if (++scrub_pos == sizeof(scrub_regs)) {
+            scrub_pos = 0;
+            scrub_passes++;
+        }
+    }
+    max7219_port_unlock();
+}
+
+uint32_t max7219_scrub_passes(void)
+{
+    return scrub_passes;
+}
+
+static inline void fb_set(int module, int row, uint8_t data){
+    back_fb[module][row] = data;
+}
+
+void drawClear(int module){
+    memset(back_fb[module], 0x00, sizeof(back_fb[module]));
 }
 
 void drawClear_range(int from, int to){
@@ -580,60 +853,62 @@ void drawClear_range(int from, int to){
 }
 
 void drawClear_all(){
-    for (int module = 0; module < NUM_MODULES; module++){
-        drawClear(module);
+    memset(back_fb, 0x00, sizeof(back_fb));
+}
+
+
+void draw_zone(int first_module, int num_modules, const uint8_t *rows){
+    max7219_port_lock();
+    for (int m = 0; m < num_modules; m++) {
+        gray_module[first_module + m] = false;
+        for (int row = 0; row < 8; row++) {
+            fb_set(first_module + m, row, rows[m * 8 + row]);
+        }
     }
+    max7219_port_unlock();
 }
 
+void draw_zone_levels(int first_module, int num_modules, const uint8_t *levels){
+    const int shift = 8 - MAX7219_GRAY_BITS_MAX;  // the top bits of a level
 
-void draw_buffer(uint8_t buf[32]) {
-    drawClear_range(8, 11);
-    for (int module = 4; module < 8; module++) {
-        int start = (module - 4) * 8;
+    max7219_port_lock();
+    for (int m = 0; m < num_modules; m++) {
+        int module = first_module + m;
         for (int row = 0; row < 8; row++) {
-            max7219_send(module+4, row+1, buf[start+row]);
+            const uint8_t *px = &levels[(m * 8 + row) * 8];
+            uint8_t planes[MAX7219_GRAY_BITS_MAX] = {0};
+            for (int col = 0; col < 8; col++) {
+                uint8_t q = px[col] >> shift;
+                for (int plane = 0; plane < MAX7219_GRAY_BITS_MAX; plane++) {
+                    if (q & (1 << plane)) {
+                        planes[plane] |= 0x80 >> col;  // bit 7 is the left-most LED
+                    }
+                }
+            }
+            for (int plane = 0; plane < MAX7219_GRAY_BITS_MAX; plane++) {
+                gray_back[plane][module][row] = planes[plane];
+            }
+            fb_set(module, row, planes[MAX7219_GRAY_BITS_MAX - 1]);
         }
+        gray_module[module] = true;
     }
+    max7219_port_unlock();
 }
 
-void draw_time(int hr, int min, int sec){
-    drawClear_range(4, 7);
+void draw_buffer(uint8_t buf[32]) {
+    draw_zone(8, 4, buf);
+}
+
+void render_time(int hr, int min, int sec, uint8_t rows[3][8]){
     int hr0 = hr / 10;
     int hr1 = hr % 10;
     int min0 = min / 10;
     int min1 = min % 10;
     int sec0 = sec / 10;
     int sec1 = sec % 10;
-    uint8_t min_pattern[8] = {
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000
-    };
-    uint8_t hr_pattern[8] = {
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000
-    };
-    uint8_t sec_pattern[8] = {
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000
-    };
+    uint8_t *hr_pattern = rows[0];
+    uint8_t *min_pattern = rows[1];
+    uint8_t *sec_pattern = rows[2];
 
     const uint8_t *min1_rows = weather_time_font7x3[min1].rows;
     const uint8_t *min0_rows = weather_time_font7x3[min0].rows;
@@ -667,38 +942,24 @@ void draw_time(int hr, int min, int sec){
             | (d1 << 1);    // puts hr1 into bits 3..1
                         // bit 4 and bit 0 are empty "spaces"
     }
+}
 
-    // draw in 8x8
-    for (int row = 0; row < 8; row++) {
-        max7219_send(4, row + 1, hr_pattern[row]);
-        max7219_send(5, row + 1, min_pattern[row]);
-        max7219_send(6, row + 1, sec_pattern[row]);
-    }
+void draw_time_rows(const uint8_t rows[3][8]){
+    uint8_t zone[4][8] = {0};  // module 7 stays blank
+    memcpy(zone, rows, 3 * 8);
+    draw_zone(4, 4, zone[0]);
 }
 
-void draw_weather(weather_data_t weather_data){
-    drawClear_range(0, 3);
-    uint8_t temp_pattern[8] = {
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000
-    };
+void draw_time(int hr, int min, int sec){
+    uint8_t rows[3][8];
+    render_time(hr, min, sec, rows);
+    draw_time_rows(rows);
+}
 
-    uint8_t wind_speed_pattern[8] = {
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000,
-        0b00000000
-    };
+void render_weather(weather_data_t weather_data, uint8_t rows[4][8]){
+    uint8_t *temp_pattern = rows[0];
+    uint8_t *wind_speed_pattern = rows[3];
+    memset(rows, 0, 4 * 8);
 
     const uint8_t *temp1_rows  = weather_time_font7x3[(weather_data.temp)%10].rows;
     const uint8_t *temp0_rows  = weather_time_font7x3[(weather_data.temp)/10].rows;
@@ -718,67 +979,42 @@ void draw_weather(weather_data_t weather_data){
         wind_speed_pattern[row] = (d0 << 5)  | (d1 << 1);                 
     }
 
-     // draw in 8x8
-    for (int row = 0; row < 8; row++) {
-        max7219_send(3, row + 1, wind_speed_pattern[row]);
-        max7219_send(1, row + 1, weather_time_font7x3[12].rows[row]);
-        max7219_send(0, row + 1, temp_pattern[row]);
-    }
+    memcpy(rows[1], weather_time_font7x3[12].rows, 8);
+}
+
+void draw_weather(weather_data_t weather_data){
+    uint8_t rows[4][8];
+    render_weather(weather_data, rows);
+    draw_zone(0, 4, rows[0]);
 }
 
 
 void draw_init(void){
+    max7219_port_lock();
     for (int row = 0; row < 8; row++) {
-        max7219_send(0, row + 1, font8x8['L' - 'A'].rows[row]);
-        max7219_send(1, row + 1, font8x8['P' - 'A'].rows[row]);
-        max7219_send(2, row + 1, font8x8['U' - 'A'].rows[row]);
+        fb_set(0, row, font8x8['L' - 'A'].rows[row]);
+        fb_set(1, row, font8x8['P' - 'A'].rows[row]);
+        fb_set(2, row, font8x8['U' - 'A'].rows[row]);
         drawClear(3);
         
-        max7219_send(4, row + 1, font8x8['S' - 'A'].rows[row]);
-        max7219_send(5, row + 1, font8x8['Y' - 'A'].rows[row]);
-        max7219_send(6, row + 1, font8x8['S' - 'A'].rows[row]);
+        fb_set(4, row, font8x8['S' - 'A'].rows[row]);
+        fb_set(5, row, font8x8['Y' - 'A'].rows[row]);
+        fb_set(6, row, font8x8['S' - 'A'].rows[row]);
         drawClear(7);
 
-        max7219_send(8, row + 1, font8x8['I' - 'A'].rows[row]);
-        max7219_send(9, row + 1, font8x8['N' - 'A'].rows[row]);
-        max7219_send(10, row + 1, font8x8['I' - 'A'].rows[row]);
-        max7219_send(11, row + 1, font8x8['I' - 'A'].rows[row]);
+        fb_set(8, row, font8x8['I' - 'A'].rows[row]);
+        fb_set(9, row, font8x8['N' - 'A'].rows[row]);
+        fb_set(10, row, font8x8['I' - 'A'].rows[row]);
+        fb_set(11, row, font8x8['I' - 'A'].rows[row]);
     }
+    max7219_port_unlock();
 }
 
 esp_err_t init_spi(){
-    init_cs();
-    const spi_bus_config_t bus_config = {
-        .miso_io_num = -1,
-        .mosi_io_num = GPIO_NUM_11,
-        .sclk_io_num = GPIO_NUM_12,
-        .quadwp_io_num = -1,
-        .quadhd_io_num = -1,
-        .data4_io_num = -1,
-        .data5_io_num = -1,
-        .data6_io_num = -1,
-        .data7_io_num = -1,
-        .max_transfer_sz = SOC_SPI_MAXIMUM_BUFFER_SIZE,
-        .data_io_default_level = 0,
-        .flags = 0,
-        .isr_cpu_id = ESP_INTR_CPU_AFFINITY_AUTO,
-        .intr_flags = 0,
-    };
-    ESP_ERROR_CHECK(spi_bus_initialize(SPI2_HOST, &bus_config, SPI_DMA_DISABLED));
-
-    spi_device_interface_config_t dev_config = {
-        .clock_speed_hz = 10 * 1000 * 1000,   // MAX7219 supports up to 10 MHz
-        .mode = 0,                            // CPOL=0, CPHA=0 (SPI mode 0)
-        .spics_io_num = -1,                   // MANUAL CS (mandatory for cascaded modules)
-        .queue_size = 1,                      // Only 1 transaction needed
-        .flags = SPI_DEVICE_HALFDUPLEX,       // MAX7219 is write-only
-        .command_bits = 0,                    // MAX7219 uses simple 16-bit frames
-        .address_bits = 0,                    // No address phase
-        .dummy_bits = 0,                      // No dummy cycles
-    };
-
-    ESP_ERROR_CHECK(spi_bus_add_device(SPI2_HOST, &dev_config, &spi));
+    esp_err_t ret = max7219_port_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
     max7219_basic_init();
-    
     return ESP_OK;
 }
\ No newline at end of file
@@ -1,17 +1,75 @@
 #ifndef MAX7219_H
 #define MAX7219_H
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 #include "../http_client/http_client.h"
 
 #define CS_PIN GPIO_NUM_10
+#define NUM_MODULES 12
+#define MAX7219_SPI_HZ (10 * 1000 * 1000)  // MAX7219 supports up to 10 MHz
 
 esp_err_t init_spi(void);
 
+void max7219_send_all(uint8_t reg, uint8_t data);
+void max7219_send(int module, uint8_t reg, uint8_t data);
+void max7219_send_chain(const uint8_t reg[NUM_MODULES], const uint8_t data[NUM_MODULES]);
+
+// Power management. Blank modules are put into shutdown (0x0C) at the end
+// of every commit and woken when they get content again; night
+// windows can turn the whole chain off or cap its brightness.
+void max7219_power_sync(void);
+void max7219_set_auto_shutdown(bool enable);
+void max7219_set_display_off(bool off);
+void max7219_set_intensity_cap(uint8_t cap);
+
+// The draw_* functions below only compose into an off-screen frame;
+// nothing reaches the modules until max7219_commit(), which sends just the
+// rows that changed (at most 8 chain transactions) and then the power
+// state. Normally called once per frame by the display task.
+void max7219_commit(void);
+uint32_t max7219_commit_count(void);
+
+// Re-send configuration and the latched rows a slice at a time so a module
+// upset by EMI recovers without a reboot. budget_bytes is this call's share
+// of the bus; a full pass over all 13 registers costs 13 * 2 * NUM_MODULES
+// bytes. Call between commits.
+void max7219_scrub(uint32_t budget_bytes);
+uint32_t max7219_scrub_passes(void);
+
+// Grayscale by binary coded modulation (see gray/gray.h for the scheduler).
+// With bits > 0 a commit no longer sends rows: it composes `bits` bit-planes
+// of the frame and hands them to max7219_gray_show(), which latches one
+// plane at a time; plane b must then stay up for 2^b time units. Modules
+// drawn with draw_zone() show the same rows in every plane, i.e. at full
+// level. bits = 0 goes back to plain on/off frames on the next commit.
+#define MAX7219_GRAY_BITS_MAX 3
+void max7219_gray_begin(int bits);
+int max7219_gray_bits(void);
+// Latch plane `plane` of the frame being shown: one chain transaction per
+// row that differs from the one before, so at most 8. A commit made since
+// the last cycle is taken over at plane 0, never half way through a cycle.
+// Returns the transactions sent.
+int max7219_gray_show(int plane);
+
+// Copy num_modules * 8 rows (module after module, top row first) into
+// the frame, starting at first_module. The other draw_* build on it.
+void draw_zone(int first_module, int num_modules, const uint8_t *rows);
+// Like draw_zone() with one level (0 = off .. 255 = full) per LED:
+// num_modules * 64 bytes, module after module, row after row, left-most
+// LED first. Without grayscale the zone shows levels of 128 and up as on.
+void draw_zone_levels(int first_module, int num_modules, const uint8_t *levels);
 void draw_buffer(uint8_t buf[32]);
 void draw_init(void);
 void draw_weather(weather_data_t weather_data);
+// Temperature, unit and wind speed for modules 0..3.
+void render_weather(weather_data_t weather_data, uint8_t rows[4][8]);
 void draw_time(int hr, int min, int sec);
+// draw_time() in two steps, so the clock can prepare the next second's
+// rows (hours, minutes, seconds modules) ahead of the tick.
+void render_time(int hr, int min, int sec, uint8_t rows[3][8]);
+void draw_time_rows(const uint8_t rows[3][8]);
 void set_all_brightness(uint8_t intensity);
 
 typedef struct {
@@ -0,0 +1,25 @@
+#ifndef MAX7219_PORT_H
+#define MAX7219_PORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Transport under the MAX7219 driver. MAX7219.c only assembles the
+// NUM_MODULES * 2 byte chain frames; the port shifts one frame out with
+// CS held low and latches it on the rising edge.
+//
+// The firmware port lives in MAX7219_spi.c (SPI2 + manual CS). The host
+// simulator in host/sim provides its own port that decodes the frames
+// into a virtual module chain.
+//
+// lock/unlock guard the driver state (back buffer, shadows) and the bus
+// against concurrent callers. They must be recursive: public driver calls
+// nest (commit -> send_chain). Ports without threads make them no-ops.
+
+esp_err_t max7219_port_init(void);
+void max7219_port_write(const uint8_t *buf, size_t len);
+void max7219_port_lock(void);
+void max7219_port_unlock(void);
+
+#endif
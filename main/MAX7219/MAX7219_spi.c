@@ -0,0 +1,101 @@
+#include "MAX7219.h"
+#include "MAX7219_port.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "esp_rom_sys.h"
+#include "soc/soc_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "../trace/trace.h"
+
+#define CS_LOW()  gpio_set_level(CS_PIN, 0)
+#define CS_HIGH() gpio_set_level(CS_PIN, 1)
+
+spi_device_handle_t spi;
+static SemaphoreHandle_t spi_lock;   // recursive, created in max7219_port_init
+
+// init CS pin
+static esp_err_t init_cs(){
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_OUTPUT,
+        .pin_bit_mask = (1ULL << CS_PIN),
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&io_conf));
+    ESP_ERROR_CHECK(CS_HIGH());   // Deselect MAX7219
+#if SOC_GPIO_SUPPORT_SLP_SWITCH
+    // Keep CS driven high through light sleep: a rising edge on wakeup
+    // would latch whatever noise shifted in meanwhile
+    gpio_sleep_sel_dis(CS_PIN);
+#endif
+    return ESP_OK;
+}
+
+void max7219_port_write(const uint8_t *buf, size_t len)
+{
+    spi_transaction_t t = {
+        .length = len * 8,
+        .tx_buffer = buf
+    };
+
+    CS_LOW();
+    spi_device_polling_transmit(spi, &t);
+    CS_HIGH();
+    esp_rom_delay_us(2); // Small delay to ensure data is latched
+}
+
+void max7219_port_lock(void)
+{
+    if (spi_lock && xSemaphoreTakeRecursive(spi_lock, 0) != pdTRUE) {
+        TRACE_BEGIN(TRACE_SPI_WAIT, 0);
+        xSemaphoreTakeRecursive(spi_lock, portMAX_DELAY);
+        TRACE_END(TRACE_SPI_WAIT, 0);
+    }
+}
+
+void max7219_port_unlock(void)
+{
+    if (spi_lock) xSemaphoreGiveRecursive(spi_lock);
+}
+
+esp_err_t max7219_port_init(void){
+    spi_lock = xSemaphoreCreateRecursiveMutex();
+    if (spi_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    init_cs();
+    const spi_bus_config_t bus_config = {
+        .miso_io_num = -1,
+        .mosi_io_num = GPIO_NUM_11,
+        .sclk_io_num = GPIO_NUM_12,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .data4_io_num = -1,
+        .data5_io_num = -1,
+        .data6_io_num = -1,
+        .data7_io_num = -1,
+        .max_transfer_sz = SOC_SPI_MAXIMUM_BUFFER_SIZE,
+        .data_io_default_level = 0,
+        .flags = 0,
+        .isr_cpu_id = ESP_INTR_CPU_AFFINITY_AUTO,
+        .intr_flags = 0,
+    };
+    ESP_ERROR_CHECK(spi_bus_initialize(SPI2_HOST, &bus_config, SPI_DMA_DISABLED));
+
+    spi_device_interface_config_t dev_config = {
+        .clock_speed_hz = MAX7219_SPI_HZ,
+        .mode = 0,                            // CPOL=0, CPHA=0 (SPI mode 0)
+        .spics_io_num = -1,                   // MANUAL CS (mandatory for cascaded modules)
+        .queue_size = 1,                      // Only 1 transaction needed
+        .flags = SPI_DEVICE_HALFDUPLEX,       // MAX7219 is write-only
+        .command_bits = 0,                    // MAX7219 uses simple 16-bit frames
+        .address_bits = 0,                    // No address phase
+        .dummy_bits = 0,                      // No dummy cycles
+    };
+
+    ESP_ERROR_CHECK(spi_bus_add_device(SPI2_HOST, &dev_config, &spi));
+    return ESP_OK;
+}
@@ -2,6 +2,11 @@
 #include "freertos/task.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_system.h"
+#include "esp_mac.h"
+#include "nvs.h"
 #include "mqtt_client.h"
 
 // #include <stdint.h>
@@ -9,15 +14,52 @@
 #include "stdio.h"
 #include <stdbool.h>
 #include "MQTT.h"
+#include "mqtt_topics.h"
+#include "../schedule/schedule.h"
+#include "../display/display.h"
+#include "../dlog/dlog.h"
+#include "../message/message.h"
+#include "../app_loop/app_loop.h"
+#include "../trace/trace.h"
+#include "../canned/canned.h"
 
 #define TAG "MQTT"
 
-TaskHandle_t heartbeat_task_handle = NULL;
-bool heartbeat_started = false;
+// An id set in NVS ("mqtt"/"device_id") wins, e.g. to keep "device1" on
+// an existing sign; otherwise it comes from the Wi-Fi MAC. "location"
+// picks the weather topic (lower-cased), MQTT_LOCATION_DEFAULT when unset
+// or not a valid name.
+#define NVS_NAMESPACE    "mqtt"
+#define NVS_KEY_ID       "device_id"
+#define NVS_KEY_LOCATION "location"
+
+static char device_id[MQTT_DEVICE_ID_MAX];
+static char location[MQTT_LOCATION_MAX];
+static char weather_topic[MQTT_TOPIC_MAX];
+static mqtt_weather_cb_t weather_cb;
+static mqtt_router_t router;
+
+// Status heartbeat, driven by an esp_timer while connected
+static esp_mqtt_client_handle_t status_client;
+static esp_timer_handle_t status_timer;
+// Previous frame count sample; the MQTT task (on connect) and the app
+// loop both publish, so the pair is swapped under status_lock
+static int64_t status_last_us;
+static uint32_t status_last_frames;
+static portMUX_TYPE status_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// With a persistent session the broker keeps our subscriptions; they only
+// have to be (re)made once per boot or when the broker lost the session.
+static bool subscribed_this_boot = false;
+
+// Payloads larger than the client's buffer come as several DATA events and
+// only the first one carries the topic; keep a copy to route the rest.
+static char chunk_topic[MQTT_TOPIC_MAX + 64];
+static mqtt_cmd_t chunk_cmd;
+static bool chunk_routed;
 
 mqtt_msg_t mqtt_msg = {
     .intensity = 15,
-    .msg = "HELLO LPU! WE ARE CIRCUIT CRAFTERS."
 };
 
 volatile bool mqtt_data_update = false;
@@ -29,60 +71,211 @@ static void log_error_if_nonzero(const char *message, int error_code)
     }
 }
 
-void mqtt_heartbeat_task(void *arg){
-    esp_mqtt_client_handle_t client = (esp_mqtt_client_handle_t)arg;
-    while (heartbeat_started) {
-        esp_mqtt_client_publish(client,
-            "/classplate/status/device1",
-            "{\"online\":true}",
-            0, 1, 0);
+// Retained status with a few health metrics. Called from the MQTT task on
+// connect and from the app loop afterwards, so it only enqueues: the MQTT
+// task sends it and neither caller waits on the network.
+static void mqtt_publish_status(void)
+{
+    char topic[MQTT_TOPIC_MAX];
+    char payload[160];
+    int64_t now = esp_timer_get_time();
+    wifi_ap_record_t ap;
+
+    mqtt_status_t st = {
+        .uptime_s = (uint32_t)(now / 1000000),
+        .rssi = esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0,
+        .free_heap = esp_get_free_heap_size(),
+        .location = location,
+        .canned_version = canned_version(),
+    };
+    // Sampled inside the lock, so the two publishers' windows never overlap
+    portENTER_CRITICAL(&status_lock);
+    int64_t at = esp_timer_get_time();
+    uint32_t frames = display_frame_count();
+    int64_t last_us = status_last_us;
+    uint32_t last_frames = status_last_frames;
+    status_last_us = at;
+    status_last_frames = frames;
+    portEXIT_CRITICAL(&status_lock);
+    if (last_us != 0 && at > last_us) {
+        st.fps_x10 = (uint32_t)((uint64_t)(frames - last_frames) * 10000000 / (uint64_t)(at - last_us));
+    }
+
+    int len = mqtt_status_payload(payload, sizeof(payload), &st);
+    if (len < 0 || len >= (int)sizeof(payload)) {
+        return;
+    }
+    mqtt_topic_format(topic, sizeof(topic), "status", device_id);
+    esp_mqtt_client_enqueue(status_client, topic, payload, len, 1, 1, true);
+}
+
+void mqtt_publish_telemetry(const char *payload, int len)
+{
+    char topic[MQTT_TOPIC_MAX];
+    if (status_client == NULL) {
+        return;
+    }
+    mqtt_topic_format(topic, sizeof(topic), "telemetry", device_id);
+    esp_mqtt_client_enqueue(status_client, topic, payload, len, 0, 0, false);
+}
+
+#if TRACE_ENABLED
+void mqtt_publish_trace(const char *payload, int len)
+{
+    char topic[MQTT_TOPIC_MAX];
+    if (status_client == NULL) {
+        return;
+    }
+    mqtt_topic_format(topic, sizeof(topic), "trace", device_id);
+    esp_mqtt_client_publish(status_client, topic, payload, len, 1, 0);
+}
+#endif
+
+static void mqtt_status_timer_cb(void *arg)
+{
+    app_loop_post(APP_EVT_STATUS_DUE, 0);
+}
+
+static void mqtt_status_due(const app_event_t *event, void *arg)
+{
+    mqtt_publish_status();
+}
+
+// Delivery receipt for a fan-out job, once the command has been applied.
+static void mqtt_ack(esp_mqtt_client_handle_t client, const char *job, int job_len)
+{
+    char payload[96];
+    char topic[MQTT_TOPIC_MAX];
+    int len = mqtt_ack_payload(payload, sizeof(payload), job, job_len);
+    if (len == 0) {
+        return;
+    }
+    mqtt_topic_format(topic, sizeof(topic), "ack", device_id);
+    esp_mqtt_client_publish(client, topic, payload, len, 1, 0);
+}
+
+// A fan-out job is followed by the same content on the retained topic;
+// the message store drops content that is already shown, so it does not
+// restart the marquee. Long messages are written chunk by chunk.
+static void mqtt_on_message(const mqtt_cmd_t *cmd, const char *data, int len, void *arg)
+{
+    if (cmd->total_len == 0) {
+        return;  // retained text cleared, a canned message took its place
+    }
+    message_write(cmd->offset, data, len, cmd->total_len);
+}
 
-        vTaskDelay(pdMS_TO_TICKS(10000));  // every 10 seconds
+static void mqtt_on_intensity(const mqtt_cmd_t *cmd, const char *data, int len, void *arg)
+{
+    if (len != cmd->total_len) {
+        return;  // never this long
+    }
+    int intensity = mqtt_parse_intensity(data, len);
+    if (xSemaphoreTake(mqtt_mutex, 0) != pdTRUE) {
+        TRACE_BEGIN(TRACE_MUTEX_WAIT, 0);
+        xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+        TRACE_END(TRACE_MUTEX_WAIT, 0);
+    }
+    if (intensity != mqtt_msg.intensity) {
+        mqtt_msg.intensity = intensity;
+        mqtt_data_update = true;
+    }
+    xSemaphoreGive(mqtt_mutex);
+}
+
+static void mqtt_on_schedule(const mqtt_cmd_t *cmd, const char *data, int len, void *arg)
+{
+    if (len != cmd->total_len) {
+        DLOGW(TAG, "schedule of %d bytes ignored", cmd->total_len);
+        return;
+    }
+    schedule_set_json(data, len);
+}
+
+static void mqtt_on_chunk(esp_mqtt_client_handle_t client, esp_mqtt_event_handle_t event)
+{
+    if (event->current_data_offset == 0) {
+        chunk_routed = false;
+        if (event->topic_len >= (int)sizeof(chunk_topic)) {
+            return;
+        }
+        memcpy(chunk_topic, event->topic, event->topic_len);
+        if (!mqtt_cmd_parse(device_id, chunk_topic, event->topic_len, &chunk_cmd)) {
+            return;
+        }
+        chunk_routed = true;
     }
-    heartbeat_task_handle = NULL;
-    vTaskDelete(NULL);
+    if (!chunk_routed) {
+        return;
+    }
+    chunk_cmd.offset = event->current_data_offset;
+    chunk_cmd.total_len = event->total_data_len;
+    if (!mqtt_router_call(&router, &chunk_cmd, event->data, event->data_len)) {
+        DLOGW(TAG, "no handler for %.*s", chunk_cmd.kind_len, chunk_cmd.kind);
+        chunk_routed = false;
+        return;
+    }
+    if (event->current_data_offset + event->data_len >= event->total_data_len) {
+        mqtt_ack(client, chunk_cmd.job, chunk_cmd.job_len);
+    }
+}
+
+// Retained commands arrive right after subscribing and restore the
+// content shown before the reboot. One filter for our own commands, one
+// for broadcasts; new kinds need no new topic.
+static void mqtt_subscribe_all(esp_mqtt_client_handle_t client)
+{
+    char topic[MQTT_TOPIC_MAX + 2];
+    int msg_id;
+
+    mqtt_cmd_filter_format(topic, sizeof(topic), device_id);
+    msg_id = esp_mqtt_client_subscribe(client, topic, 1);
+    ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+
+    mqtt_cmd_filter_format(topic, sizeof(topic), MQTT_BROADCAST_ID);
+    msg_id = esp_mqtt_client_subscribe(client, topic, 1);
+    ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+
+    // Weather for our location, retained, so the last fetch comes right
+    // away; the HTTP fetch is only a fallback
+    msg_id = esp_mqtt_client_subscribe(client, weather_topic, 1);
+    ESP_LOGI(TAG, "subscribed to %s, msg_id=%d", weather_topic, msg_id);
+    subscribed_this_boot = true;
 }
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
     ESP_LOGD(TAG, "Event dispatched from event loop base=%s, event_id=%" PRIi32 "", base, event_id);
     esp_mqtt_event_handle_t event = event_data;
+    TRACE_INSTANT(TRACE_MQTT_EVENT, event_id);
     esp_mqtt_client_handle_t client = event->client;
-    int msg_id;
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
             // msg_id = esp_mqtt_client_publish(client, "/classplate/status", "data_3", 0, 1, 0);
             
-            msg_id = esp_mqtt_client_publish(client, "/classplate/status/device1", "{\"online\":true}", 0, 1, 0);
-            ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
-            // esp_mqtt_client_subscribe(client, "/classplate/message/device1", 0);
-            // esp_mqtt_client_subscribe(client, "/classplate/intensity/device1", 1);
-            msg_id = esp_mqtt_client_subscribe(client, "/classplate/message/device1", 0);
-            ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
-
-            msg_id = esp_mqtt_client_subscribe(client, "/classplate/intensity/device1", 1);
-            ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
-
-            // Start heartbeat task ONLY once
-            if (!heartbeat_started) {
-                heartbeat_started = true;
-                xTaskCreate(mqtt_heartbeat_task, "mqtt_heartbeat_task", 4096, 
-                    client,      // pass MQTT client handle
-                    5, &heartbeat_task_handle);
+            // Birth message, retained so the dashboard knows right away
+            mqtt_publish_status();
+            esp_timer_stop(status_timer);  // not running after a clean disconnect
+            esp_timer_start_periodic(status_timer, (uint64_t)MQTT_HEARTBEAT_MS * 1000);
+
+            if (subscribed_this_boot && event->session_present) {
+                ESP_LOGI(TAG, "session resumed, subscriptions kept by the broker");
+            } else {
+                mqtt_subscribe_all(client);
             }
+
             // msg_id = esp_mqtt_client_unsubscribe(client, "/topic/qos1");
             // ESP_LOGI(TAG, "sent unsubscribe successful, msg_id=%d", msg_id);
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
-            if (heartbeat_started) {
-                heartbeat_started = false;  // Task will exit its loop
-            }
+            // the Last Will reports us offline, nothing to send meanwhile
+            esp_timer_stop(status_timer);
             break;
 
         case MQTT_EVENT_SUBSCRIBED:
-            ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
+            DLOGD(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
             // msg_id = esp_mqtt_client_publish(client, "/topic/qos0", "data", 0, 0, 0);
             // ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
             break;
@@ -90,27 +283,32 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
             break;
         case MQTT_EVENT_PUBLISHED:
-            ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            DLOGD(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
             break;
         case MQTT_EVENT_DATA:
             // CREATE CALLBACK FUNTIONS HERE
-            ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-            printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
-            printf("DATA=%.*s\r\n", event->data_len, event->data);
-            
-            xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+            DLOGD(TAG, "MQTT_EVENT_DATA %.*s", event->topic_len, event->topic);
+            DLOGV(TAG, "DATA=%.*s", event->data_len, event->data);
 
-            mqtt_data_update = true;
-            if(strncmp(event->topic, "/classplate/intensity/device1", event->topic_len) == 0) {
-                mqtt_msg.intensity = atoi(event->data);
+            if (event->topic_len == (int)strlen(weather_topic) &&
+                memcmp(event->topic, weather_topic, event->topic_len) == 0) {
+                mqtt_weather_t weather;
+                if (weather_cb != NULL && mqtt_parse_weather(event->data, event->data_len, &weather)) {
+                    weather_cb(&weather);
+                }
+                break;
             }
-            if(strncmp(event->topic, "/classplate/message/device1", event->topic_len) == 0) {
-                strncpy(mqtt_msg.msg, event->data, event->data_len);
-                mqtt_msg.msg[event->data_len] = '\0';
+            if (event->data_len < event->total_data_len) {
+                mqtt_on_chunk(client, event);
+                break;
             }
-
-            xSemaphoreGive(mqtt_mutex);
-
+            mqtt_cmd_t cmd;
+            if (!mqtt_router_dispatch(&router, device_id, event->topic, event->topic_len,
+                                      event->data, event->data_len, &cmd)) {
+                DLOGW(TAG, "no handler for %.*s", event->topic_len, event->topic);
+                break;
+            }
+            mqtt_ack(client, cmd.job, cmd.job_len);
             break;
         case MQTT_EVENT_ERROR:
             ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
@@ -122,19 +320,114 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             }
             break;
         default:
-            ESP_LOGI(TAG, "Other event id:%d", event->event_id);
+            DLOGD(TAG, "Other event id:%d", event->event_id);
             break;
         }
 }
 
+static void mqtt_load_config(void)
+{
+    nvs_handle_t nvs;
+    size_t len = sizeof(device_id);
+    size_t loc_len = sizeof(location);
+    esp_err_t ret = ESP_FAIL;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        ret = nvs_get_str(nvs, NVS_KEY_ID, device_id, &len);
+        if (nvs_get_str(nvs, NVS_KEY_LOCATION, location, &loc_len) != ESP_OK) {
+            location[0] = '\0';
+        }
+        nvs_close(nvs);
+    }
+    if (location[0] != '\0' && !mqtt_location_normalize(location)) {
+        ESP_LOGW(TAG, "location \"%s\" is not [a-z0-9_-], using %s", location, MQTT_LOCATION_DEFAULT);
+        location[0] = '\0';
+    }
+    if (location[0] == '\0') {
+        strcpy(location, MQTT_LOCATION_DEFAULT);
+    }
+    if (ret == ESP_OK && device_id[0] != '\0') {
+        return;
+    }
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(device_id, sizeof(device_id), "cp-%02x%02x%02x%02x%02x%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+const char *mqtt_device_id(void)
+{
+    return device_id;
+}
+
+const char *mqtt_location(void)
+{
+    return location;
+}
+
+void mqtt_on_weather(mqtt_weather_cb_t cb)
+{
+    weather_cb = cb;
+}
+
+esp_err_t mqtt_register_command(const char *kind, mqtt_cmd_handler_t handler, void *arg)
+{
+    if (mqtt_router_add(&router, kind, handler, arg) != 0) {
+        ESP_LOGE(TAG, "Cannot register command \"%s\"", kind);
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
 esp_err_t mqtt_init(void){
+    mqtt_load_config();
+    mqtt_topic_format(weather_topic, sizeof(weather_topic), "weather", location);
+    ESP_LOGI(TAG, "device id %s, weather for %s", device_id, location);
+    esp_err_t ret = mqtt_register_command("message", mqtt_on_message, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = mqtt_register_command("intensity", mqtt_on_intensity, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = mqtt_register_command("schedule", mqtt_on_schedule, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Stable client id + persistent session: QoS 1 commands sent while we
+    // were offline are queued by the broker. The Last Will flips our
+    // retained status to offline as soon as the broker loses us.
+    static char will_topic[MQTT_TOPIC_MAX];
+    static char client_id[sizeof("classplate_") + MQTT_DEVICE_ID_MAX];
+    mqtt_topic_format(will_topic, sizeof(will_topic), "status", device_id);
+    snprintf(client_id, sizeof(client_id), "classplate_%s", device_id);
+
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker.address.uri = MQTT_BROKER_URL,
+        .credentials.client_id = client_id,
+        .session = {
+            .disable_clean_session = true,
+            .keepalive = MQTT_KEEPALIVE_S,
+            .last_will = {
+                .topic = will_topic,
+                .msg = MQTT_STATUS_OFFLINE,
+                .qos = 1,
+                .retain = 1,
+            },
+        },
     };
 
     esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
+    status_client = client;
+
+    const esp_timer_create_args_t status_timer_args = {
+        .callback = mqtt_status_timer_cb,
+        .name = "mqtt_status",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&status_timer_args, &status_timer));
+    app_loop_register(APP_EVT_STATUS_DUE, mqtt_status_due, NULL);
     /* The last argument may be used to pass data to the event handler */
     ESP_ERROR_CHECK(esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL));
-    esp_err_t ret = esp_mqtt_client_start(client);
-    return ret;
+    return esp_mqtt_client_start(client);
 }
\ No newline at end of file
@@ -4,18 +4,42 @@
 #include "esp_err.h"
 #include <stdbool.h>
 #include "freertos/semphr.h"
+#include "mqtt_topics.h"
 
 #define MQTT_BROKER_URL "mqtt://broker.hivemq.com:1883"
 
+// The message text itself lives in message/message.h.
 typedef struct _mqtt_msg_t{
     int intensity;
-    char msg[128];
 } mqtt_msg_t;
 
 extern mqtt_msg_t mqtt_msg;
 extern volatile bool mqtt_data_update;
 extern SemaphoreHandle_t mqtt_mutex;
 
+// Handlers run on the MQTT task; a command with a job id is acked once its
+// handler returns. Register before mqtt_init() so nothing is dispatched
+// while the table changes.
+esp_err_t mqtt_register_command(const char *kind, mqtt_cmd_handler_t handler, void *arg);
+
 esp_err_t mqtt_init(void);
+// From NVS or the MAC, valid once mqtt_init() ran.
+const char *mqtt_device_id(void);
+// Weather location from NVS ("mqtt"/"location"), MQTT_LOCATION_DEFAULT
+// otherwise. Valid once mqtt_init() ran.
+const char *mqtt_location(void);
+
+// Called on the MQTT task for every weather push for our location,
+// including the retained one right after connecting. Set before mqtt_init().
+typedef void (*mqtt_weather_cb_t)(const mqtt_weather_t *weather);
+void mqtt_on_weather(mqtt_weather_cb_t cb);
+// QoS 0 on /classplate/telemetry/<device>, dropped while disconnected.
+// Does not block, safe from esp_timer callbacks.
+void mqtt_publish_telemetry(const char *payload, int len);
+#if TRACE_ENABLED
+// QoS 1 on /classplate/trace/<device>. Waits for the socket, call it from
+// the app loop only. Only in trace builds (trace.h).
+void mqtt_publish_trace(const char *payload, int len);
+#endif
 
 #endif
\ No newline at end of file
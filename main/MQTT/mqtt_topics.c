@@ -0,0 +1,223 @@
+#include "mqtt_topics.h"
+#include <stdio.h>
+#include <string.h>
+
+int mqtt_topic_format(char *buf, size_t size, const char *kind, const char *device_id)
+{
+    int len = snprintf(buf, size, MQTT_TOPIC_ROOT "/%s/%s", kind, device_id);
+    return (len < 0 || (size_t)len >= size) ? -1 : len;
+}
+
+int mqtt_cmd_topic_format(char *buf, size_t size, const char *device_id, const char *kind)
+{
+    int len = snprintf(buf, size, MQTT_TOPIC_ROOT "/" MQTT_CMD_SEGMENT "/%s/%s", device_id, kind);
+    return (len < 0 || (size_t)len >= size) ? -1 : len;
+}
+
+int mqtt_cmd_filter_format(char *buf, size_t size, const char *device_id)
+{
+    return mqtt_cmd_topic_format(buf, size, device_id, "#");
+}
+
+// Consume "<seg>/" at *p if the topic continues with exactly that segment.
+static bool take_segment(const char **p, const char *end, const char *seg, int seg_len)
+{
+    if (end - *p < seg_len + 1 || memcmp(*p, seg, seg_len) != 0 || (*p)[seg_len] != '/') {
+        return false;
+    }
+    *p += seg_len + 1;
+    return true;
+}
+
+bool mqtt_cmd_parse(const char *device_id, const char *topic, int topic_len, mqtt_cmd_t *cmd)
+{
+    static const char prefix[] = MQTT_TOPIC_ROOT "/" MQTT_CMD_SEGMENT;
+    const char *p = topic;
+    const char *end = topic + topic_len;
+
+    if (!take_segment(&p, end, prefix, sizeof(prefix) - 1)) {
+        return false;
+    }
+    if (take_segment(&p, end, device_id, strlen(device_id))) {
+        cmd->broadcast = false;
+    } else if (take_segment(&p, end, MQTT_BROADCAST_ID, sizeof(MQTT_BROADCAST_ID) - 1)) {
+        cmd->broadcast = true;
+    } else {
+        return false;
+    }
+
+    const char *slash = memchr(p, '/', end - p);
+    cmd->kind = p;
+    cmd->kind_len = (slash ? slash : end) - p;
+    cmd->job = NULL;
+    cmd->job_len = 0;
+    if (slash) {
+        cmd->job = slash + 1;
+        cmd->job_len = end - cmd->job;
+    }
+    // empty kind, or a trailing slash without a job id
+    return cmd->kind_len > 0 && (slash == NULL || cmd->job_len > 0);
+}
+
+// FNV-1a
+static unsigned route_slot(const char *kind, int len)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)kind[i]) * 16777619u;
+    }
+    return h & (MQTT_ROUTES_MAX - 1);
+}
+
+static const mqtt_route_t *route_find(const mqtt_router_t *router, const char *kind, int len)
+{
+    unsigned slot = route_slot(kind, len);
+    for (int i = 0; i < MQTT_ROUTES_MAX; i++) {
+        const mqtt_route_t *r = &router->slots[(slot + i) & (MQTT_ROUTES_MAX - 1)];
+        if (r->kind == NULL) {
+            return NULL;
+        }
+        if (r->kind_len == len && memcmp(r->kind, kind, len) == 0) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+int mqtt_router_add(mqtt_router_t *router, const char *kind, mqtt_cmd_handler_t handler, void *arg)
+{
+    int len = strlen(kind);
+    // at most half full, so a miss ends on a free slot after a probe or two
+    if (len == 0 || handler == NULL || router->count >= MQTT_ROUTES_MAX / 2 ||
+        route_find(router, kind, len) != NULL) {
+        return -1;
+    }
+    unsigned slot = route_slot(kind, len);
+    while (router->slots[slot].kind != NULL) {
+        slot = (slot + 1) & (MQTT_ROUTES_MAX - 1);
+    }
+    router->slots[slot] = (mqtt_route_t){
+        .kind = kind,
+        .kind_len = len,
+        .handler = handler,
+        .arg = arg,
+    };
+    router->count++;
+    return 0;
+}
+
+bool mqtt_router_dispatch(const mqtt_router_t *router, const char *device_id,
+                          const char *topic, int topic_len,
+                          const char *data, int len, mqtt_cmd_t *cmd)
+{
+    if (!mqtt_cmd_parse(device_id, topic, topic_len, cmd)) {
+        return false;
+    }
+    cmd->offset = 0;
+    cmd->total_len = len;
+    return mqtt_router_call(router, cmd, data, len);
+}
+
+bool mqtt_router_call(const mqtt_router_t *router, const mqtt_cmd_t *cmd,
+                      const char *data, int len)
+{
+    const mqtt_route_t *r = route_find(router, cmd->kind, cmd->kind_len);
+    if (r == NULL) {
+        return false;
+    }
+    r->handler(cmd, data, len, r->arg);
+    return true;
+}
+
+int mqtt_ack_payload(char *buf, size_t size, const char *job, int job_len)
+{
+    if (job == NULL || job_len == 0 || job_len > 64) {
+        return 0;
+    }
+    int len = snprintf(buf, size, "{\"id\":\"%.*s\",\"ok\":true}", job_len, job);
+    return (len < 0 || (size_t)len >= size) ? 0 : len;
+}
+
+int mqtt_status_payload(char *buf, size_t size, const mqtt_status_t *st)
+{
+    int len = snprintf(buf, size,
+                       "{\"online\":true,\"uptime\":%lu,\"rssi\":%d,\"heap\":%lu,\"fps\":%lu.%lu",
+                       (unsigned long)st->uptime_s, st->rssi, (unsigned long)st->free_heap,
+                       (unsigned long)(st->fps_x10 / 10), (unsigned long)(st->fps_x10 % 10));
+    if (len < 0 || (size_t)len >= size) {
+        return len;
+    }
+    if (st->location != NULL) {
+        len += snprintf(buf + len, size - len, ",\"loc\":\"%s\"", st->location);
+    }
+    if (st->canned_version != 0 && (size_t)len < size) {
+        len += snprintf(buf + len, size - len, ",\"cv\":%lu", (unsigned long)st->canned_version);
+    }
+    if ((size_t)len < size) {
+        len += snprintf(buf + len, size - len, "}");
+    }
+    return len;
+}
+
+int mqtt_parse_intensity(const char *data, int len)
+{
+    // payload is not NUL terminated
+    int value = 0;
+    for (int i = 0; i < len && data[i] >= '0' && data[i] <= '9'; i++) {
+        value = value * 10 + (data[i] - '0');
+        if (value > 15) return 15;
+    }
+    return value;
+}
+
+// Signed decimal of up to 10 digits at *pos, which is moved past it and
+// the ',' after it.
+static bool parse_field(const char *data, int len, int *pos, int64_t *out)
+{
+    int i = *pos;
+    bool negative = i < len && data[i] == '-';
+    if (negative) {
+        i++;
+    }
+    int start = i;
+    int64_t value = 0;
+    for (; i < len && data[i] >= '0' && data[i] <= '9'; i++) {
+        value = value * 10 + (data[i] - '0');
+    }
+    if (i == start || i - start > 10) {
+        return false;
+    }
+    *out = negative ? -value : value;
+    *pos = i < len && data[i] == ',' ? i + 1 : i;
+    return true;
+}
+
+bool mqtt_location_normalize(char *location)
+{
+    int i = 0;
+    for (; location[i] != '\0'; i++) {
+        char c = location[i];
+        if (c >= 'A' && c <= 'Z') {
+            c = location[i] = c - 'A' + 'a';
+        }
+        if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '-')) {
+            return false;
+        }
+    }
+    return i > 0 && i < MQTT_LOCATION_MAX;
+}
+
+bool mqtt_parse_weather(const char *data, int len, mqtt_weather_t *weather)
+{
+    int64_t temp, wind, fetched;
+    int pos = 0;
+    if (!parse_field(data, len, &pos, &temp) || !parse_field(data, len, &pos, &wind) ||
+        !parse_field(data, len, &pos, &fetched) || fetched < 0 || fetched > UINT32_MAX ||
+        temp < 0 || temp > MQTT_WEATHER_MAX || wind < 0 || wind > MQTT_WEATHER_MAX) {
+        return false;
+    }
+    weather->temp = (int)temp;
+    weather->wind_speed = (int)wind;
+    weather->fetched = (uint32_t)fetched;
+    return true;
+}
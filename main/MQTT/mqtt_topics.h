@@ -0,0 +1,148 @@
+#ifndef MQTT_TOPICS_H
+#define MQTT_TOPICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Topic layout, command routing and payloads shared by the firmware
+// (MQTT.c) and the host load generator, which runs many virtual devices
+// through the same code. Nothing in here touches the network.
+
+#define MQTT_TOPIC_ROOT       "/classplate"
+#define MQTT_TOPIC_MAX        96
+// Status is retained: the birth message on connect and the Last Will the
+// broker publishes when the connection dies make online/offline instant,
+// the heartbeat only refreshes lastSeen and covers a dead broker.
+#define MQTT_HEARTBEAT_MS     60000  // every minute
+#define MQTT_STATUS_ONLINE    "{\"online\":true}"
+#define MQTT_STATUS_OFFLINE   "{\"online\":false}"
+#define MQTT_KEEPALIVE_S      30
+
+// Device -> server topics are "/classplate/<kind>/<device_id>" (status,
+// ack, telemetry). Commands go the other way on
+//
+//   /classplate/cmd/<device_id>/<kind>[/<jobId>]
+//   /classplate/cmd/all/<kind>[/<jobId>]        broadcast
+//
+// so a device needs one wildcard subscription for its own commands and one
+// for broadcasts, and a new command kind needs no new subscription.
+#define MQTT_CMD_SEGMENT      "cmd"
+#define MQTT_BROADCAST_ID     "all"
+#define MQTT_DEVICE_ID_MAX    32
+#define MQTT_ROUTES_MAX       32  // power of two, at most half of it used
+
+// Kinds registered at boot: sync, wall, canned, show, gray, trace, message,
+// intensity, schedule. Bump this with every new mqtt_register_command().
+#define MQTT_CMD_KINDS        9
+_Static_assert((MQTT_ROUTES_MAX & (MQTT_ROUTES_MAX - 1)) == 0,
+               "MQTT_ROUTES_MAX must be a power of two");
+_Static_assert(MQTT_CMD_KINDS <= MQTT_ROUTES_MAX / 2,
+               "too many MQTT command kinds for the router");
+
+typedef struct {
+    const char *kind;  // points into the topic, not NUL terminated
+    int kind_len;
+    const char *job;   // fan-out job id inside the topic, NULL if none
+    int job_len;
+    bool broadcast;
+    // Where this call's data sits in the payload. Large payloads reach the
+    // handler in several calls; len == total_len means it is all there.
+    int offset;
+    int total_len;
+} mqtt_cmd_t;
+
+typedef void (*mqtt_cmd_handler_t)(const mqtt_cmd_t *cmd, const char *data, int len, void *arg);
+
+typedef struct {
+    const char *kind;  // NULL: free slot
+    int kind_len;
+    mqtt_cmd_handler_t handler;
+    void *arg;
+} mqtt_route_t;
+
+// Command kind -> handler, open addressing on a hash of the kind, so
+// routing costs the same however many commands are registered.
+typedef struct {
+    mqtt_route_t slots[MQTT_ROUTES_MAX];
+    int count;
+} mqtt_router_t;
+
+// "/classplate/<kind>/<device_id>", returns the length or -1 if it does
+// not fit.
+int mqtt_topic_format(char *buf, size_t size, const char *kind, const char *device_id);
+
+// "/classplate/cmd/<device_id>/<kind>", same return as above.
+int mqtt_cmd_topic_format(char *buf, size_t size, const char *device_id, const char *kind);
+
+// "/classplate/cmd/<device_id>/#", the subscription for all its commands.
+int mqtt_cmd_filter_format(char *buf, size_t size, const char *device_id);
+
+// Split a command topic addressed to device_id or to everyone. False if
+// the topic is something else.
+bool mqtt_cmd_parse(const char *device_id, const char *topic, int topic_len, mqtt_cmd_t *cmd);
+
+// kind must stay valid (a literal). Returns 0, or -1 if the kind is
+// already taken or the table is full.
+int mqtt_router_add(mqtt_router_t *router, const char *kind, mqtt_cmd_handler_t handler, void *arg);
+
+// Parse the topic and call the handler of its kind. Returns false if the
+// topic is not a command for us or nobody handles its kind; *cmd is
+// filled in either way when the topic parsed.
+bool mqtt_router_dispatch(const mqtt_router_t *router, const char *device_id,
+                          const char *topic, int topic_len,
+                          const char *data, int len, mqtt_cmd_t *cmd);
+
+// Call the handler of cmd->kind with data at cmd->offset of the payload,
+// for payloads that arrive in pieces. False if nobody handles the kind.
+bool mqtt_router_call(const mqtt_router_t *router, const mqtt_cmd_t *cmd,
+                      const char *data, int len);
+
+// Delivery receipt for a fan-out job, published on the ack topic once the
+// command has been applied. Returns the length, 0 if there is nothing to ack.
+int mqtt_ack_payload(char *buf, size_t size, const char *job, int job_len);
+
+// Device metrics carried by the status heartbeat.
+typedef struct {
+    uint32_t uptime_s;
+    int rssi;            // dBm, 0 if not associated
+    uint32_t free_heap;  // bytes
+    uint32_t fps_x10;    // display frames per second, times 10
+    const char *location; // weather location, NULL to leave it out
+    uint32_t canned_version; // canned messages held, 0 to leave it out
+} mqtt_status_t;
+
+// {"online":true,"uptime":..,"rssi":..,"heap":..,"fps":..,"loc":..,"cv":..},
+// returns the length (snprintf style). "loc" tells the server which
+// locations to fetch weather for, "cv" whether the sign can be sent
+// canned message ids (canned.h).
+int mqtt_status_payload(char *buf, size_t size, const mqtt_status_t *st);
+
+// "<int>" payload of an intensity command, clamped to 0..15.
+int mqtt_parse_intensity(const char *data, int len);
+
+// Weather, fetched once per location by the server and retained on
+//
+//   /classplate/weather/<location>   "<temp>,<wind_speed>,<fetched>"
+//
+// temp in °C, wind in km/h, fetched the Unix time the server got it.
+// The sign draws two digits of each, so both must be 0..MQTT_WEATHER_MAX.
+#define MQTT_WEATHER_MAX       99
+#define MQTT_LOCATION_MAX      32
+#define MQTT_LOCATION_DEFAULT  "jalandhar"
+
+typedef struct {
+    int temp;
+    int wind_speed;
+    uint32_t fetched;
+} mqtt_weather_t;
+
+// Lower-case a location in place. False unless it is 1..31 of [a-z0-9_-]
+// afterwards, the same rule the server applies to the "loc" it is sent,
+// so both sides name the same weather topic.
+bool mqtt_location_normalize(char *location);
+
+// False unless all three fields are there and temp and wind are in range.
+bool mqtt_parse_weather(const char *data, int len, mqtt_weather_t *weather);
+
+#endif
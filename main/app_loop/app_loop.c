@@ -0,0 +1,85 @@
+#include "app_loop.h"
+#include "../trace/trace.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#define TAG "APP_LOOP"
+
+typedef struct {
+    app_handler_t handler;
+    void *arg;
+} app_slot_t;
+
+static QueueHandle_t queue;
+static app_slot_t slots[APP_EVT_MAX][APP_LOOP_HANDLERS_MAX];
+static app_loop_stats_t stats;
+
+esp_err_t app_loop_init(void){
+    queue = xQueueCreate(APP_LOOP_QUEUE_LEN, sizeof(app_event_t));
+    return queue != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t app_loop_register(app_event_id_t id, app_handler_t handler, void *arg){
+    if (id >= APP_EVT_MAX || handler == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < APP_LOOP_HANDLERS_MAX; i++) {
+        if (slots[id][i].handler == NULL) {
+            slots[id][i] = (app_slot_t){handler, arg};
+            return ESP_OK;
+        }
+    }
+    ESP_LOGE(TAG, "No free handler slot for event %d", id);
+    return ESP_ERR_NO_MEM;
+}
+
+bool app_loop_post(app_event_id_t id, uint32_t arg){
+    app_event_t event = {
+        .id = id,
+        .arg = arg,
+        .posted_us = esp_timer_get_time(),
+    };
+    if (queue == NULL || xQueueSend(queue, &event, 0) != pdTRUE) {
+        __atomic_fetch_add(&stats.dropped, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    return true;
+}
+
+void app_loop_run(void){
+    ESP_LOGI(TAG, "running");
+    while (1) {
+        app_event_t event;
+        if (xQueueReceive(queue, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        int64_t start = esp_timer_get_time();
+        uint32_t latency = (uint32_t)(start - event.posted_us);
+        TRACE_BEGIN(TRACE_APP_EVENT, event.id);
+        for (int i = 0; i < APP_LOOP_HANDLERS_MAX && slots[event.id][i].handler != NULL; i++) {
+            slots[event.id][i].handler(&event, slots[event.id][i].arg);
+        }
+        uint32_t busy = (uint32_t)(esp_timer_get_time() - start);
+        TRACE_END(TRACE_APP_EVENT, event.id);
+
+        stats.events++;
+        stats.latency_avg_us += ((int32_t)latency - (int32_t)stats.latency_avg_us) / 16;
+        if (latency > stats.latency_max_us) {
+            stats.latency_max_us = latency;
+        }
+        if (busy > stats.busy_max_us) {
+            stats.busy_max_us = busy;
+            stats.busy_max_id = event.id;
+        }
+        if (busy > APP_LOOP_SLOW_US) {
+            ESP_LOGW(TAG, "event %d took %lu ms", event.id, (unsigned long)(busy / 1000));
+        }
+    }
+}
+
+void app_loop_get_stats(app_loop_stats_t *out){
+    *out = stats;  // torn reads only skew one telemetry sample
+}
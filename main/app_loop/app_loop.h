@@ -0,0 +1,68 @@
+#ifndef APP_LOOP_H
+#define APP_LOOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// The application event loop.
+//
+// Timers, Wi-Fi and MQTT only post a small event here; the work they
+// trigger (a status publish, a telemetry sample) runs in registered
+// handlers on one task, the boot task once it is done booting. So there
+// is no stack per feature, and the time from post to handler is measured
+// in one place (app_loop_get_stats()).
+//
+// Handlers must not block on the network. The display task runs beside
+// it because frames must not wait for a handler, and the weather fallback
+// has its own task because an HTTP fetch may take seconds; its handler
+// only wakes that task.
+
+typedef enum {
+    APP_EVT_NET_UP,          // got an IP
+    APP_EVT_NET_DOWN,        // lost the AP
+    APP_EVT_WEATHER_DUE,
+    APP_EVT_STATUS_DUE,      // MQTT status heartbeat
+    APP_EVT_TELEMETRY_DUE,
+    APP_EVT_TRACE_DUMP,      // arg: 0 = MQTT, 1 = console
+    APP_EVT_MAX,
+} app_event_id_t;
+
+typedef struct {
+    app_event_id_t id;
+    uint32_t arg;
+    int64_t posted_us;
+} app_event_t;
+
+typedef void (*app_handler_t)(const app_event_t *event, void *arg);
+
+#define APP_LOOP_QUEUE_LEN     16
+#define APP_LOOP_HANDLERS_MAX   2   // per event
+// Handlers running longer than this are logged; they hold up every event.
+#define APP_LOOP_SLOW_US   500000
+
+typedef struct {
+    uint32_t events;
+    uint32_t dropped;        // queue was full
+    uint32_t latency_avg_us; // post -> handler start, running average (1/16)
+    uint32_t latency_max_us;
+    uint32_t busy_max_us;    // longest single event, all handlers
+    app_event_id_t busy_max_id;
+} app_loop_stats_t;
+
+// Create the queue; call before anything registers or posts.
+esp_err_t app_loop_init(void);
+
+// Call from the boot task before app_loop_run(); the table is not locked.
+esp_err_t app_loop_register(app_event_id_t id, app_handler_t handler, void *arg);
+
+// From any task or esp_timer callback. Never blocks: false (and counted)
+// when the queue is full.
+bool app_loop_post(app_event_id_t id, uint32_t arg);
+
+// Handle events forever on the calling task.
+void app_loop_run(void) __attribute__((noreturn));
+
+void app_loop_get_stats(app_loop_stats_t *stats);
+
+#endif
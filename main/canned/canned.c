@@ -0,0 +1,255 @@
+#include "canned.h"
+#include "../MQTT/MQTT.h"
+#include "../marquee/marquee.h"
+#include "../dlog/dlog.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "CANNED"
+
+typedef struct {
+    uint16_t id;
+    uint16_t off;    // text in the payload buffer
+    uint16_t len;
+    int col;         // columns in strips, set when rendered
+    int cols;
+} canned_entry_t;
+
+typedef struct {
+    uint32_t version;
+    int count;
+    canned_entry_t entries[CANNED_MAX];
+    char *text;      // the payload as received, NUL terminated
+    uint8_t *strips; // columns of every entry, heap
+} canned_dict_t;
+
+// Double buffered like message.c: the MQTT task parses and renders into
+// dicts[target] while the display task scrolls from dicts[shown].
+static canned_dict_t dicts[2];
+static int shown = 1;
+static int pending = -1;
+static int target;
+static uint32_t version;          // newest complete dictionary
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Selection, written by the MQTT task
+static uint32_t selected;
+static uint32_t select_seq;
+static int64_t selected_at;       // esp_timer time of the selection
+
+// Display task only
+static uint32_t seen_seq;
+static bool showing;              // the zone shows (or waits for) selected
+
+uint32_t canned_version(void){
+    return __atomic_load_n(&version, __ATOMIC_RELAXED);
+}
+
+// Parse "<version>\n<id>\t<text>\n..." in place
+static bool parse(canned_dict_t *d, int size){
+    const char *p = d->text;
+    const char *end = d->text + size;
+    char *num_end;
+
+    d->version = strtoul(p, &num_end, 10);
+    if (num_end == p || d->version == 0) {
+        return false;
+    }
+    p = num_end;
+    d->count = 0;
+    while (p < end) {
+        if (*p == '\n') {
+            p++;
+            continue;
+        }
+        const char *line_end = memchr(p, '\n', end - p);
+        if (line_end == NULL) {
+            line_end = end;
+        }
+        const char *tab = memchr(p, '\t', line_end - p);
+        long id = tab != NULL ? strtol(p, &num_end, 10) : -1;
+        if (tab == NULL || num_end != tab || id < 0 || id > CANNED_ID_MAX) {
+            DLOGW(TAG, "bad entry at byte %d", (int)(p - d->text));
+        } else if (d->count == CANNED_MAX) {
+            DLOGW(TAG, "more than %d entries, rest dropped", CANNED_MAX);
+            break;
+        } else {
+            canned_entry_t *e = &d->entries[d->count++];
+            e->id = (uint16_t)id;
+            e->off = (uint16_t)(tab + 1 - d->text);
+            e->len = (uint16_t)(line_end - tab - 1);
+        }
+        p = line_end;
+    }
+    return true;
+}
+
+// Render every entry once, into one allocation. MQTT task, on a buffer
+// the display task does not look at.
+static void render(canned_dict_t *d){
+    free(d->strips);
+    d->strips = NULL;
+    int total = 0;
+    for (int i = 0; i < d->count; i++) {
+        canned_entry_t *e = &d->entries[i];
+        e->col = total;
+        e->cols = marquee_render(d->text + e->off, e->len, NULL);
+        total += e->cols;
+    }
+    if (total == 0) {
+        return;
+    }
+    d->strips = heap_caps_malloc(total, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (d->strips == NULL) {
+        d->strips = heap_caps_malloc(total, MALLOC_CAP_8BIT);
+    }
+    if (d->strips == NULL) {
+        ESP_LOGE(TAG, "No memory for %d columns", total);
+        d->count = 0;
+        return;
+    }
+    for (int i = 0; i < d->count; i++) {
+        const canned_entry_t *e = &d->entries[i];
+        marquee_render(d->text + e->off, e->len, d->strips + e->col);
+    }
+}
+
+// MQTT task
+static void canned_on_dict(const mqtt_cmd_t *cmd, const char *data, int len, void *arg){
+    if (dicts[0].text == NULL || cmd->total_len == 0) {
+        return;  // no memory, or the retained dictionary was cleared
+    }
+    if (cmd->total_len > CANNED_BYTES_MAX) {
+        if (cmd->offset == 0) {
+            DLOGW(TAG, "dictionary of %d bytes ignored", cmd->total_len);
+        }
+        return;
+    }
+    if (cmd->offset == 0) {
+        // The reader never looks at the other buffer until it is pending
+        portENTER_CRITICAL(&lock);
+        target = shown ^ 1;
+        pending = -1;
+        portEXIT_CRITICAL(&lock);
+    }
+    memcpy(dicts[target].text + cmd->offset, data, len);
+    if (cmd->offset + len < cmd->total_len) {
+        return;
+    }
+
+    canned_dict_t *d = &dicts[target];
+    d->text[cmd->total_len] = '\0';
+    // Nothing pending now, so shown is stable. Only the leading number is
+    // looked at when the display already has this dictionary.
+    if (strtoul(d->text, NULL, 10) == dicts[shown].version) {
+        return;
+    }
+    if (!parse(d, cmd->total_len)) {
+        DLOGW(TAG, "dictionary without a version ignored");
+        return;
+    }
+    render(d);
+    portENTER_CRITICAL(&lock);
+    pending = target;
+    portEXIT_CRITICAL(&lock);
+    __atomic_store_n(&version, d->version, __ATOMIC_RELAXED);
+    DLOGI(TAG, "dictionary %lu, %d messages", (unsigned long)d->version, d->count);
+}
+
+// MQTT task
+static void canned_on_show(const mqtt_cmd_t *cmd, const char *data, int len, void *arg){
+    if (len != cmd->total_len || len == 0 || len > 4) {
+        return;  // cleared, or not an id
+    }
+    uint32_t id = 0;
+    for (int i = 0; i < len; i++) {
+        if (data[i] < '0' || data[i] > '9') {
+            return;
+        }
+        id = id * 10 + (data[i] - '0');
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lock);
+    selected = id;
+    selected_at = now;
+    select_seq++;
+    portEXIT_CRITICAL(&lock);
+}
+
+bool canned_pending(void){
+    return __atomic_load_n(&pending, __ATOMIC_RELAXED) >= 0 ||
+           __atomic_load_n(&select_seq, __ATOMIC_RELAXED) != seen_seq;
+}
+
+bool canned_take(const uint8_t **cols, int *n, int64_t *at){
+    bool new_dict = false;
+    portENTER_CRITICAL(&lock);
+    if (pending >= 0) {
+        shown = pending;
+        pending = -1;
+        new_dict = true;
+    }
+    uint32_t seq = select_seq;
+    uint32_t id = selected;
+    *at = selected_at;
+    portEXIT_CRITICAL(&lock);
+
+    bool changed = false;
+    if (new_dict) {
+        changed = showing;  // its columns just moved
+    }
+    if (seq != seen_seq) {
+        seen_seq = seq;
+        showing = true;
+        changed = true;
+    }
+    if (!changed) {
+        return false;
+    }
+
+    const canned_dict_t *d = &dicts[shown];
+    if (d->version == 0) {
+        return false;  // no dictionary yet, switch once it is here
+    }
+    *cols = NULL;
+    *n = 0;
+    for (int i = 0; i < d->count; i++) {
+        if (d->entries[i].id == id) {
+            *cols = d->strips + d->entries[i].col;
+            *n = d->entries[i].cols;
+            return true;
+        }
+    }
+    DLOGW(TAG, "no message %lu in dictionary %lu", (unsigned long)id, (unsigned long)d->version);
+    return true;
+}
+
+void canned_hide(void){
+    showing = false;
+}
+
+esp_err_t canned_start(void){
+    const int size = CANNED_BYTES_MAX + 1;
+    char *text = heap_caps_malloc(2 * size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (text == NULL) {
+        text = heap_caps_malloc(2 * size, MALLOC_CAP_8BIT);
+    }
+    if (text == NULL) {
+        ESP_LOGE(TAG, "No memory for the dictionary");
+        return ESP_ERR_NO_MEM;
+    }
+    dicts[0].text = text;
+    dicts[1].text = text + size;
+
+    esp_err_t ret = mqtt_register_command("canned", canned_on_dict, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return mqtt_register_command("show", canned_on_show, NULL);
+}
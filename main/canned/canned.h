@@ -0,0 +1,46 @@
+#ifndef CANNED_H
+#define CANNED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Canned messages: a dictionary of short texts kept in sync by the
+// server, so showing one of them takes its id instead of its text.
+//
+//   /classplate/cmd/all/canned   "<version>\n<id>\t<text>\n..."  retained
+//   /classplate/cmd/<id>/show    "<id>"
+//
+// version identifies the list's content; the retained dictionary arriving
+// again on every reconnect costs one comparison. A new dictionary is
+// rendered into marquee columns once, on the MQTT task into the buffer
+// that is not shown, so the display task only swaps pointers: switching
+// to an entry costs no copy, no allocation and no glyph lookups while it
+// scrolls. The version held is reported in the status ("cv"); signs
+// that lag behind get the text instead of the id from the server.
+
+#define CANNED_MAX        64    // entries
+#define CANNED_BYTES_MAX  4096  // dictionary payload
+#define CANNED_ID_MAX     9999
+
+// Allocate the dictionary and register its commands; before mqtt_init().
+esp_err_t canned_start(void);
+
+// Version of the newest complete dictionary, 0 before the first one.
+uint32_t canned_version(void);
+
+// Display task: true if a selection or dictionary waits for canned_take().
+bool canned_pending(void);
+
+// Display task: take a new selection or dictionary. True when the zone
+// must switch to *cols (n columns for marquee_set_cols(), NULL and 0 if
+// the selected id is not in the dictionary); *at is when the selection
+// came in (esp_timer time), to order it against a message. The previous
+// columns must not be used after this.
+bool canned_take(const uint8_t **cols, int *n, int64_t *at);
+
+// Display task: something else replaced the canned message on screen; a
+// new dictionary then no longer switches the zone back to it.
+void canned_hide(void);
+
+#endif
@@ -0,0 +1,136 @@
+#include "clock.h"
+#include "../MAX7219/MAX7219.h"
+#include "../display/display.h"
+#include "../schedule/schedule.h"
+#include "../widget/widget.h"
+#include "../trace/trace.h"
+
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define TAG "CLOCK"
+
+typedef struct {
+    time_t second;
+    bool on_tick;         // false for the first frame after clock_start()
+    struct tm tm;
+    uint8_t rows[3][8];
+} clock_frame_t;
+
+// Two frames: the one handed to the display and the one being prepared
+// for the next second, so the timer never writes what the vsync reads.
+static clock_frame_t frames[2];
+static int next_frame;          // timer side: frame prepared for the coming second
+static int ready = -1;          // frame to show next, -1 if none
+static int shown;               // frame the widget renders
+static esp_timer_handle_t tick_timer;
+static clock_stats_t stats;
+static widget_t clock_widget;
+
+static int64_t wall_us(void){
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void prepare(clock_frame_t *f, time_t second, bool on_tick){
+    f->second = second;
+    f->on_tick = on_tick;
+    localtime_r(&second, &f->tm);
+    render_time(f->tm.tm_hour, f->tm.tm_min, f->tm.tm_sec, f->rows);
+}
+
+static void arm(time_t second){
+    int64_t wait = (int64_t)second * 1000000 - wall_us();
+    esp_timer_start_once(tick_timer, wait > 0 ? wait : 0);
+}
+
+static void clock_tick(void *arg){
+    // The timer may fire a little early or late: take the nearest boundary
+    time_t second = (time_t)((wall_us() + 500000) / 1000000);
+    TRACE_INSTANT(TRACE_CLOCK_TICK, (uint32_t)second);
+
+    clock_frame_t *f = &frames[next_frame];
+    if (f->second != second) {
+        prepare(f, second, true);  // time was stepped since the last tick
+    }
+    __atomic_store_n(&ready, next_frame, __ATOMIC_RELEASE);
+    widget_invalidate(&clock_widget);
+    display_kick();
+
+    next_frame ^= 1;
+    prepare(&frames[next_frame], second + 1, true);
+    arm(second + 1);
+}
+
+static bool clock_update(widget_t *w){
+    int idx = __atomic_exchange_n(&ready, -1, __ATOMIC_ACQUIRE);
+    if (idx < 0) {
+        return false;
+    }
+    const clock_frame_t *f = &frames[idx];
+    shown = idx;
+
+    if (f->on_tick) {
+        // The commit follows right after the widgets have run
+        int32_t err = (int32_t)(wall_us() - (int64_t)f->second * 1000000);
+        stats.ticks++;
+        stats.last_us = err;
+        stats.avg_us += (err - stats.avg_us) / 16;
+        if (abs(err) > stats.max_us) {
+            stats.max_us = abs(err);
+        }
+        if (abs(err) > CLOCK_LATE_US) {
+            stats.late++;
+        }
+    }
+
+    schedule_apply(&f->tm);
+    return true;
+}
+
+static void clock_render(widget_t *w, uint8_t *rows){
+    memcpy(rows, frames[shown].rows, sizeof(frames[shown].rows));  // module 7 stays blank
+}
+
+void clock_get_stats(clock_stats_t *out){
+    *out = stats;  // a torn read only skews one sample of telemetry
+}
+
+esp_err_t clock_start(void){
+    const esp_timer_create_args_t args = {
+        .callback = clock_tick,
+        .name = "clock",
+    };
+    esp_err_t ret = esp_timer_create(&args, &tick_timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Show the current second at once, then tick on the boundaries
+    time_t now = (time_t)(wall_us() / 1000000);
+    prepare(&frames[0], now, false);
+    prepare(&frames[1], now + 1, true);
+    next_frame = 1;
+    __atomic_store_n(&ready, 0, __ATOMIC_RELEASE);
+
+    clock_widget.name = "clock";
+    clock_widget.first_module = 4;
+    clock_widget.num_modules = 4;
+    clock_widget.update = clock_update;
+    clock_widget.render = clock_render;
+    ret = widget_add(&clock_widget);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    display_kick();
+    arm(now + 1);
+    ESP_LOGI(TAG, "ticking on the second");
+    return ESP_OK;
+}
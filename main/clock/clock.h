@@ -0,0 +1,30 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// The clock zone, ticked on the wall-clock second.
+//
+// A one-shot esp_timer is armed for the next second boundary from
+// gettimeofday(), and re-armed from the time it actually fired, so timer
+// drift and SNTP corrections never accumulate. The rows for the coming
+// second are rendered a second ahead; at the boundary the timer only
+// hands them over, invalidates the clock widget and kicks the display
+// task, which draws them and commits right away.
+
+typedef struct {
+    uint32_t ticks;
+    int32_t last_us;    // commit start - second boundary, last tick
+    int32_t avg_us;     // running average (1/16 weight)
+    int32_t max_us;     // largest absolute error since boot
+    uint32_t late;      // ticks more than CLOCK_LATE_US off
+} clock_stats_t;
+
+#define CLOCK_LATE_US  5000
+
+// Call once the time is set (after SNTP sync) and the display runs.
+esp_err_t clock_start(void);
+void clock_get_stats(clock_stats_t *stats);
+
+#endif
@@ -0,0 +1,122 @@
+#include "display.h"
+#include <stdbool.h>
+#include "../MAX7219/MAX7219.h"
+#include "../telemetry/task_stacks.h"
+#include "../trace/trace.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#define TAG "DISPLAY"
+
+// Bytes the bus can move in one frame, times the scrubber's share.
+#define SCRUB_BUDGET_BYTES \
+    ((uint32_t)((uint64_t)MAX7219_SPI_HZ / 8 * DISPLAY_FRAME_MS / 1000 * DISPLAY_SCRUB_PERMILLE / 1000))
+
+typedef struct {
+    display_vsync_cb_t cb;
+    void *arg;
+} vsync_slot_t;
+
+static vsync_slot_t vsync_slots[DISPLAY_VSYNC_MAX];
+static volatile int vsync_count;
+static uint32_t frames_done;  // read by the status publisher
+
+// Display task only, collected from the callbacks of one frame
+static uint32_t idle_until;
+static int idle_votes;
+
+uint32_t display_frame_count(void){
+    return __atomic_load_n(&frames_done, __ATOMIC_RELAXED);
+}
+
+esp_err_t display_vsync_register(display_vsync_cb_t cb, void *arg){
+    if (cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (vsync_count >= DISPLAY_VSYNC_MAX) {
+        ESP_LOGE(TAG, "No free vsync slot");
+        return ESP_ERR_NO_MEM;
+    }
+    // Fill the slot before publishing it, the display task may be running.
+    vsync_slots[vsync_count].cb = cb;
+    vsync_slots[vsync_count].arg = arg;
+    __atomic_store_n(&vsync_count, vsync_count + 1, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+void display_idle_until(uint32_t frame){
+    if (idle_votes == 0 || (int32_t)(frame - idle_until) < 0) {
+        idle_until = frame;
+    }
+    idle_votes++;
+}
+
+static TaskHandle_t display_task_handle;
+
+void display_kick(void){
+    if (display_task_handle != NULL) {
+        xTaskNotifyGive(display_task_handle);
+    }
+}
+
+static void display_task(void *pvParameters){
+    const TickType_t slot_ticks = pdMS_TO_TICKS(DISPLAY_FRAME_MS);
+    const TickType_t start = xTaskGetTickCount();
+    uint32_t frame = 0;         // slot of the frame being run
+    uint32_t scrubbed = 0;      // slot of the last scrub
+    uint32_t next = 0;          // slot the regular cadence wakes up for
+
+    while (1) {
+        TRACE_BEGIN(TRACE_FRAME, frame);
+        idle_votes = 0;
+        int count = __atomic_load_n(&vsync_count, __ATOMIC_ACQUIRE);
+        for (int i = 0; i < count; i++) {
+            vsync_slots[i].cb(frame, vsync_slots[i].arg);
+        }
+        TRACE_BEGIN(TRACE_COMMIT, frame);
+        max7219_commit();
+        TRACE_END(TRACE_COMMIT, frame);
+        // The scrubber's share of the bus accrues over skipped slots too
+        // (it caps the credit itself)
+        TRACE_BEGIN(TRACE_SCRUB, frame);
+        uint32_t slots = frame - scrubbed;
+        max7219_scrub(SCRUB_BUDGET_BYTES * (slots < 1 ? 1 : slots > 2 ? 2 : slots));
+        scrubbed = frame;
+        TRACE_END(TRACE_SCRUB, frame);
+        TRACE_END(TRACE_FRAME, frame);
+        __atomic_fetch_add(&frames_done, 1, __ATOMIC_RELAXED);
+
+        // A kicked frame is extra, the regular cadence stays where it was
+        if ((int32_t)(frame - next) >= 0) {
+            next = frame + 1;
+            if (count > 0 && idle_votes == count && (int32_t)(idle_until - next) > 0) {
+                uint32_t idle = idle_until - frame;
+                next = frame + (idle < DISPLAY_IDLE_MAX_FRAMES ? idle : DISPLAY_IDLE_MAX_FRAMES);
+            }
+        }
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wake = start + next * slot_ticks;
+        if ((int32_t)(wake - now) <= 0) {
+            // overran, don't try to catch up: run the current slot now
+            frame = (now - start) / slot_ticks;
+            next = frame;
+            continue;
+        }
+        // Sleep until the next slot we need, or less if someone kicks us
+        if (ulTaskNotifyTake(pdTRUE, wake - now) != 0) {
+            frame = (xTaskGetTickCount() - start) / slot_ticks;
+        } else {
+            frame = next;
+        }
+    }
+}
+
+esp_err_t display_start(void){
+    // One above the other display producers so frames stay evenly spaced.
+    if (xTaskCreate(display_task, "display_task", TASK_STACK_DISPLAY, NULL, 6, &display_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create display task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,45 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define DISPLAY_FRAME_MS   20  // commit period, 50 Hz
+#define DISPLAY_VSYNC_MAX   4
+// Longest the display task sleeps when no callback needs a frame, so the
+// scrubber keeps going and an invalidated widget without a kick waits at
+// most this many frame slots.
+#define DISPLAY_IDLE_MAX_FRAMES 5
+// Share of the SPI bus, in permille, given to the register scrubber. At
+// 1 permille one slice goes out about every frame and the whole chain is
+// re-asserted roughly every 260 ms.
+#define DISPLAY_SCRUB_PERMILLE 1
+
+// Called from the display task once per frame, right before the frame is
+// committed. Whatever a callback draws lands on the same commit as every
+// other zone, so scrolling and clock ticks change together and no half
+// drawn zone is ever latched. Callbacks must not block.
+//
+// frame is the frame slot (DISPLAY_FRAME_MS each since display_start()),
+// so periods counted in frames hold even when slots are skipped.
+typedef void (*display_vsync_cb_t)(uint32_t frame, void *arg);
+
+// From a vsync callback: nothing for it to do before frame slot `frame`.
+// When every callback said so, the display task sleeps through the slots
+// in between (up to DISPLAY_IDLE_MAX_FRAMES) instead of waking 50 times a
+// second for nothing; display_kick() still wakes it at once.
+void display_idle_until(uint32_t frame);
+
+// Frames committed since display_start(), for frame rate telemetry.
+uint32_t display_frame_count(void);
+
+// Run a frame (vsync callbacks + commit) now instead of at the next
+// frame slot, for content that must land at an exact moment. Safe from
+// any task or esp_timer callback, not from an ISR.
+void display_kick(void);
+
+esp_err_t display_vsync_register(display_vsync_cb_t cb, void *arg);
+// Start the frame task; call after init_spi().
+esp_err_t display_start(void);
+
+#endif
@@ -0,0 +1,122 @@
+#include "dlog.h"
+#include "../telemetry/task_stacks.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Bounded multi-producer queue (Vyukov): a producer claims a position by
+// advancing head with a CAS, fills the slot and then publishes it through
+// the slot's sequence number. The drain task is the only consumer.
+//
+// seq is kept relative to the slot index (real sequence = seq + index) so
+// the zero-initialised ring is already valid before dlog_init().
+
+typedef struct {
+    uint32_t seq;
+    esp_log_level_t level;
+    const char *tag;      // tags are literals
+    uint32_t timestamp;   // ms since boot
+    char text[DLOG_LINE_MAX];
+} dlog_slot_t;
+
+static dlog_slot_t ring[DLOG_SLOTS];
+static uint32_t head;     // next position to claim
+static uint32_t tail;     // next position to drain, consumer only
+static uint32_t dropped;
+static uint32_t dropped_reported;
+static TaskHandle_t drain_task;
+
+static inline uint32_t slot_seq(uint32_t pos){
+    dlog_slot_t *slot = &ring[pos & (DLOG_SLOTS - 1)];
+    return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) + (pos & (DLOG_SLOTS - 1));
+}
+
+static inline void slot_publish(uint32_t pos, uint32_t seq){
+    dlog_slot_t *slot = &ring[pos & (DLOG_SLOTS - 1)];
+    __atomic_store_n(&slot->seq, seq - (pos & (DLOG_SLOTS - 1)), __ATOMIC_RELEASE);
+}
+
+void dlog_write(esp_log_level_t level, const char *tag, const char *fmt, ...){
+    uint32_t pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    while (1) {
+        int32_t dif = (int32_t)(slot_seq(pos) - pos);
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+            // pos was reloaded by the failed CAS
+        } else if (dif < 0) {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);  // full
+            return;
+        } else {
+            pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        }
+    }
+
+    dlog_slot_t *slot = &ring[pos & (DLOG_SLOTS - 1)];
+    slot->level = level;
+    slot->tag = tag;
+    slot->timestamp = esp_log_timestamp();
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(slot->text, sizeof(slot->text), fmt, ap);
+    va_end(ap);
+    slot_publish(pos, pos + 1);
+
+    // Dropped lines need no wakeup, the ones that filled the ring gave one
+    TaskHandle_t task = __atomic_load_n(&drain_task, __ATOMIC_ACQUIRE);
+    if (task != NULL) {
+        xTaskNotifyGive(task);
+    }
+}
+
+uint32_t dlog_dropped(void){
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+static char level_letter(esp_log_level_t level){
+    switch (level) {
+        case ESP_LOG_ERROR:   return 'E';
+        case ESP_LOG_WARN:    return 'W';
+        case ESP_LOG_INFO:    return 'I';
+        case ESP_LOG_DEBUG:   return 'D';
+        default:              return 'V';
+    }
+}
+
+static void dlog_task(void *pvParameters){
+    while (1) {
+        // Same line format as ESP_LOGx, so both kinds read alike
+        while (slot_seq(tail) == tail + 1) {
+            dlog_slot_t *slot = &ring[tail & (DLOG_SLOTS - 1)];
+            printf("%c (%lu) %s: %s\n", level_letter(slot->level),
+                   (unsigned long)slot->timestamp, slot->tag, slot->text);
+            slot_publish(tail, tail + DLOG_SLOTS);
+            tail++;
+        }
+
+        uint32_t lost = dlog_dropped();
+        if (lost != dropped_reported) {
+            printf("W (%lu) DLOG: %lu log lines dropped\n",
+                   (unsigned long)esp_log_timestamp(), (unsigned long)(lost - dropped_reported));
+            dropped_reported = lost;
+        }
+        // Until the next line; no periodic wakeups keeping the chip out of
+        // light sleep
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+esp_err_t dlog_init(void){
+    // Lowest priority above idle: logs go out when nothing else runs
+    if (xTaskCreate(dlog_task, "dlog", TASK_STACK_DLOG, NULL, 1, &drain_task) != pdPASS) {
+        ESP_LOGE("DLOG", "Failed to create log task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,54 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+// Deferred logging for hot paths (display vsync, MQTT event handler).
+//
+// DLOGx() formats the line into a lock-free ring buffer, wakes the drain
+// task and returns; that low-priority task writes it to the console later,
+// so a slow UART never stalls a frame, and sleeps while there is nothing
+// to print. Not for ISRs or critical sections. When the ring is full the
+// line is dropped and counted (dlog_dropped(), also in the telemetry)
+// instead of waiting.
+//
+// Levels are ESP-IDF's. Anything above DLOG_LEVEL is compiled out, the
+// arguments are not even evaluated; the default follows the project's
+// default log level, so debug lines cost nothing in a release build.
+
+#ifndef DLOG_LEVEL
+#ifdef CONFIG_LOG_DEFAULT_LEVEL
+#define DLOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#else
+#define DLOG_LEVEL ESP_LOG_INFO
+#endif
+#endif
+
+#define DLOG_SLOTS      32   // power of two
+#define DLOG_LINE_MAX   96   // longer lines are cut
+
+void dlog_write(esp_log_level_t level, const char *tag, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define DLOG_AT(level, tag, fmt, ...) do {                      \
+        if ((level) <= DLOG_LEVEL) {                            \
+            dlog_write(level, tag, fmt, ##__VA_ARGS__);         \
+        }                                                       \
+    } while (0)
+
+#define DLOGE(tag, fmt, ...) DLOG_AT(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) DLOG_AT(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) DLOG_AT(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) DLOG_AT(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+#define DLOGV(tag, fmt, ...) DLOG_AT(ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
+// Start the drain task. Lines logged before this are kept (up to
+// DLOG_SLOTS) and written once it runs.
+esp_err_t dlog_init(void);
+
+// Lines lost to a full ring since boot.
+uint32_t dlog_dropped(void);
+
+#endif
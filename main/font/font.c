@@ -0,0 +1,223 @@
+#include "font.h"
+#include "../MAX7219/MAX7219.h"
+#include <string.h>
+
+#define FONT_MAGIC        "CPF1"
+#define FONT_VERSION      1
+#define FONT_HEADER_LEN   24
+#define FONT_INDEX_ENTRY  8
+#define FONT_REPLACEMENT  0xFFFD
+
+typedef struct {
+    const uint8_t *index;
+    const uint8_t *data;
+    uint32_t count;
+    uint32_t data_len;
+    uint32_t default_cp;
+    uint8_t height;
+} font_t;
+
+static font_t font;           // count == 0 -> legacy table
+static font_glyph_t cache[FONT_CACHE_SLOTS];
+static font_stats_t stats;
+
+// The blob may sit in memory-mapped flash: read it bytewise, never cast.
+static inline uint32_t rd32(const uint8_t *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t rd16(const uint8_t *p){
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t crc32_ieee(const uint8_t *p, size_t len){
+    uint32_t crc = 0xFFFFFFFF;
+    while (len--) {
+        crc ^= *p++;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// Whether an index entry's columns end inside the data section. A stream's
+// length depends on its columns, so this walks the flag bits.
+static bool glyph_fits(const uint8_t *entry, const uint8_t *data, uint32_t data_len, uint8_t height){
+    uint32_t ow = rd32(entry + 4);
+    uint32_t off = ow & 0x00FFFFFF;
+    uint8_t width = (uint8_t)(ow >> 24);
+    if (width > FONT_WIDTH_MAX || off > data_len) {
+        return false;
+    }
+    const uint8_t *p = data + off;
+    uint64_t bits = (uint64_t)(data_len - off) * 8;
+    uint64_t bit = 0;
+    for (int x = 0; x < width; x++) {
+        if (bit >= bits) {
+            return false;
+        }
+        bool fresh = (p[bit >> 3] >> (7 - (bit & 7))) & 1;
+        bit += fresh ? 1 + height : 1;
+    }
+    return bit <= bits;
+}
+
+static void cache_clear(void){
+    for (int i = 0; i < FONT_CACHE_SLOTS; i++) {
+        cache[i].cp = UINT32_MAX;  // not a codepoint
+    }
+}
+
+esp_err_t font_load(const uint8_t *blob, size_t len){
+    cache_clear();
+    memset(&font, 0, sizeof(font));
+    stats = (font_stats_t){0};
+    if (blob == NULL) {
+        return ESP_OK;
+    }
+
+    if (len < FONT_HEADER_LEN || memcmp(blob, FONT_MAGIC, 4) != 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (rd16(blob + 4) != FONT_VERSION) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    uint8_t height = blob[6];
+    uint32_t count = rd32(blob + 8);
+    uint32_t data_len = rd32(blob + 12);
+    if (height == 0 || height > 8 || count == 0 ||
+        count > (len - FONT_HEADER_LEN) / FONT_INDEX_ENTRY ||
+        data_len > len - FONT_HEADER_LEN - (size_t)count * FONT_INDEX_ENTRY) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t body_len = (size_t)count * FONT_INDEX_ENTRY + data_len;
+    if (crc32_ieee(blob + FONT_HEADER_LEN, body_len) != rd32(blob + 16)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    // The CRC only says the blob is what was written; a bad offset or
+    // width would still send font_decode() past the data.
+    const uint8_t *index = blob + FONT_HEADER_LEN;
+    const uint8_t *data = index + (size_t)count * FONT_INDEX_ENTRY;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!glyph_fits(index + (size_t)i * FONT_INDEX_ENTRY, data, data_len, height)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    font.index = blob + FONT_HEADER_LEN;
+    font.data = font.index + (size_t)count * FONT_INDEX_ENTRY;
+    font.count = count;
+    font.data_len = data_len;
+    font.default_cp = rd32(blob + 20);
+    font.height = height;
+    stats.glyphs = count;
+    return ESP_OK;
+}
+
+// Binary search of the sorted index, returns the entry or NULL.
+static const uint8_t *font_find(uint32_t cp){
+    uint32_t lo = 0, hi = font.count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const uint8_t *e = font.index + (size_t)mid * FONT_INDEX_ENTRY;
+        uint32_t c = rd32(e);
+        if (c == cp) return e;
+        if (c < cp) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+// Columns are a bit stream: '0' repeats the previous column, '1' is
+// followed by `height` bits of a new one, top row first.
+static void font_decode(const uint8_t *entry, font_glyph_t *g){
+    uint32_t ow = rd32(entry + 4);
+    uint32_t off = ow & 0x00FFFFFF;
+    uint8_t width = (uint8_t)(ow >> 24);
+
+    // font_load() checked that every glyph ends inside the data
+    const uint8_t *p = font.data + off;
+    uint32_t bit = 0;
+    uint8_t prev = 0;
+
+    #define NEXT_BIT() ((p[bit >> 3] >> (7 - (bit & 7))) & 1)
+    for (int x = 0; x < width; x++) {
+        if (NEXT_BIT()) {
+            bit++;
+            prev = 0;
+            for (int y = 0; y < font.height; y++, bit++) {
+                prev |= NEXT_BIT() << y;
+            }
+        } else {
+            bit++;
+        }
+        g->cols[x] = prev;
+    }
+    #undef NEXT_BIT
+    g->width = width;
+}
+
+static void legacy_glyph(uint32_t cp, font_glyph_t *g){
+    const uint8_t *rows;
+    if (cp >= 'A' && cp <= 'Z') rows = string_font6x5[cp - 'A'].rows;
+    else if (cp == '!') rows = string_font6x5[27].rows;
+    else if (cp == '.') rows = string_font6x5[28].rows;
+    else rows = string_font6x5[26].rows;  // ' ' and everything else
+    memcpy(g->cols, rows, 5);
+    g->width = 5;
+}
+
+void font_glyph_read(uint32_t cp, font_glyph_t *g){
+    memset(g->cols, 0, sizeof(g->cols));
+    if (font.count == 0) {
+        legacy_glyph(cp, g);
+    } else {
+        const uint8_t *e = font_find(cp);
+        if (e == NULL) e = font_find(font.default_cp);
+        if (e == NULL) e = font.index;  // broken default, any glyph will do
+        font_decode(e, g);
+    }
+    g->cp = cp;
+}
+
+const font_glyph_t *font_glyph(uint32_t cp){
+    font_glyph_t *g = &cache[cp & (FONT_CACHE_SLOTS - 1)];
+    if (g->cp == cp) {
+        stats.cache_hits++;
+        return g;
+    }
+    stats.cache_misses++;
+    font_glyph_read(cp, g);
+    return g;
+}
+
+uint32_t font_utf8_next(const char *s, int len, int *used){
+    const uint8_t *u = (const uint8_t *)s;
+    *used = 1;
+    if (len <= 0) return FONT_REPLACEMENT;
+    if (u[0] < 0x80) return u[0];
+
+    int n;
+    uint32_t cp, min;
+    if ((u[0] & 0xE0) == 0xC0)      { n = 2; cp = u[0] & 0x1F; min = 0x80; }
+    else if ((u[0] & 0xF0) == 0xE0) { n = 3; cp = u[0] & 0x0F; min = 0x800; }
+    else if ((u[0] & 0xF8) == 0xF0) { n = 4; cp = u[0] & 0x07; min = 0x10000; }
+    else return FONT_REPLACEMENT;   // stray continuation or invalid lead byte
+
+    if (n > len) return FONT_REPLACEMENT;
+    for (int i = 1; i < n; i++) {
+        if ((u[i] & 0xC0) != 0x80) return FONT_REPLACEMENT;
+        cp = (cp << 6) | (u[i] & 0x3F);
+    }
+    // overlong forms, surrogates and out of range values
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        return FONT_REPLACEMENT;
+    }
+    *used = n;
+    return cp;
+}
+
+font_stats_t font_get_stats(void){
+    return stats;
+}
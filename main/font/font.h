@@ -0,0 +1,53 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Message font. Glyphs come from a CPF1 blob (tools/mkfont.py) that the
+// firmware maps straight out of the "font" flash partition, so only the
+// small decoded-glyph cache below lives in RAM whatever the font size.
+// Without a valid blob the legacy string_font6x5 table is used.
+
+#define FONT_WIDTH_MAX   8
+#define FONT_CACHE_SLOTS 32  // direct mapped, must be a power of two
+
+#define FONT_PARTITION_TYPE    0x40
+#define FONT_PARTITION_SUBTYPE 0x00
+#define FONT_PARTITION_LABEL   "font"
+
+typedef struct {
+    uint32_t cp;
+    uint8_t width;
+    uint8_t cols[FONT_WIDTH_MAX];  // bit 0 = top row, like string_font6x5
+} font_glyph_t;
+
+typedef struct {
+    uint32_t glyphs;       // glyphs in the active blob, 0 = legacy table
+    uint32_t cache_hits;
+    uint32_t cache_misses;
+} font_stats_t;
+
+// Map the font partition and activate it (firmware only, font_partition.c).
+esp_err_t font_init(void);
+
+// Validate a blob and make it the active font. The blob must stay mapped
+// for as long as it is active. NULL goes back to the legacy table.
+esp_err_t font_load(const uint8_t *blob, size_t len);
+
+// Glyph for a codepoint, the font's default glyph when it has none.
+// Never NULL. The cache is not locked; only the render task may call this.
+const font_glyph_t *font_glyph(uint32_t cp);
+
+// The same glyph decoded into *g, bypassing the cache. Safe from any task
+// once the font is loaded, for rendering off the display task.
+void font_glyph_read(uint32_t cp, font_glyph_t *g);
+
+// Decode one UTF-8 sequence from s (at most len bytes). Stores the number
+// of bytes consumed in *used (>= 1) and returns U+FFFD for malformed input.
+uint32_t font_utf8_next(const char *s, int len, int *used);
+
+font_stats_t font_get_stats(void);
+
+#endif
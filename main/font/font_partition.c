@@ -0,0 +1,37 @@
+#include "font.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#define TAG "FONT"
+
+static esp_partition_mmap_handle_t font_mmap;
+
+esp_err_t font_init(void){
+    font_load(NULL, 0);  // legacy table until the partition checks out
+
+    const esp_partition_t *part = esp_partition_find_first(FONT_PARTITION_TYPE,
+                                                           FONT_PARTITION_SUBTYPE,
+                                                           FONT_PARTITION_LABEL);
+    if (part == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, using built-in A-Z font", FONT_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const void *blob;
+    esp_err_t ret = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &blob, &font_mmap);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "mmap of '%s' failed: %s", FONT_PARTITION_LABEL, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = font_load(blob, part->size);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "'%s' holds no valid font (%s), using built-in A-Z font",
+                 FONT_PARTITION_LABEL, esp_err_to_name(ret));
+        esp_partition_munmap(font_mmap);
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "%" PRIu32 " glyphs mapped from '%s'", font_get_stats().glyphs, FONT_PARTITION_LABEL);
+    return ESP_OK;
+}
@@ -0,0 +1,159 @@
+#include "gray.h"
+#include "../MAX7219/MAX7219.h"
+#include "../MQTT/MQTT.h"
+#include "../dlog/dlog.h"
+#include "../telemetry/task_stacks.h"
+#include "../trace/trace.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#define TAG "GRAY"
+
+static TaskHandle_t gray_task_handle;
+static esp_timer_handle_t slot_timer;
+static int wanted_bits;          // written by gray_set_bits(), read by the task
+static gray_stats_t stats;
+#if CONFIG_PM_ENABLE
+// Waking from light sleep takes longer than the shortest slot
+static esp_pm_lock_handle_t no_sleep;
+#endif
+
+static void hold_awake(bool on){
+#if CONFIG_PM_ENABLE
+    if (on) {
+        esp_pm_lock_acquire(no_sleep);
+    } else {
+        esp_pm_lock_release(no_sleep);
+    }
+#endif
+}
+
+static void slot_timer_cb(void *arg){
+    xTaskNotifyGive(gray_task_handle);
+}
+
+static void record_load(uint32_t load_us, int64_t late_us){
+    stats.load_avg_us += ((int32_t)load_us - (int32_t)stats.load_avg_us) / 16;
+    if (load_us > stats.load_max_us) {
+        stats.load_max_us = load_us;
+    }
+    if (late_us > stats.late_max_us) {
+        stats.late_max_us = (uint32_t)late_us;
+    }
+}
+
+static void gray_task(void *pvParameters){
+    int bits = 0;
+    int plane = 0;
+    int64_t unit_us = 0;
+    int64_t slot_at = 0;        // when the current plane should go up
+
+    while (1) {
+        int want = __atomic_load_n(&wanted_bits, __ATOMIC_RELAXED);
+        if (want != bits) {
+            esp_timer_stop(slot_timer);
+            if ((bits == 0) != (want == 0)) {
+                hold_awake(want != 0);
+            }
+            max7219_gray_begin(want);
+            bits = want;
+            stats.bits = (uint8_t)bits;
+            plane = 0;
+            if (bits) {
+                unit_us = GRAY_CYCLE_US / ((1 << bits) - 1);
+                slot_at = esp_timer_get_time();
+                DLOGI(TAG, "%d bit-planes, %lld us unit", bits, (long long)unit_us);
+            } else {
+                DLOGI(TAG, "off");
+            }
+        }
+        if (!bits) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  // until switched on
+            continue;
+        }
+
+        int64_t start = esp_timer_get_time();
+        TRACE_BEGIN(TRACE_GRAY_PLANE, plane);
+        max7219_gray_show(plane);
+        TRACE_END(TRACE_GRAY_PLANE, plane);
+        int64_t now = esp_timer_get_time();
+        record_load((uint32_t)(now - start), start - slot_at);
+
+        // The next slot follows from the schedule, not from when this
+        // plane actually went up. If it is already due, drop the lag
+        // instead of racing through the following slots to catch up.
+        slot_at += unit_us << plane;
+        if (slot_at <= now) {
+            stats.overruns++;
+            slot_at = now;
+        }
+        if (++plane == bits) {
+            plane = 0;
+            stats.cycles++;
+        }
+        esp_timer_start_once(slot_timer, slot_at - now);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+esp_err_t gray_set_bits(int bits){
+    if (bits != 0 && (bits < 2 || bits > MAX7219_GRAY_BITS_MAX ||
+                      GRAY_CYCLE_US / ((1 << bits) - 1) < GRAY_UNIT_MIN_US)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (gray_task_handle == NULL) {
+        if (bits == 0) {
+            return ESP_OK;  // never switched on
+        }
+        const esp_timer_create_args_t args = {
+            .callback = slot_timer_cb,
+            .name = "gray",
+        };
+        esp_err_t ret = esp_timer_create(&args, &slot_timer);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+#if CONFIG_PM_ENABLE
+        ret = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "gray", &no_sleep);
+        if (ret != ESP_OK) {
+            esp_timer_delete(slot_timer);
+            return ret;
+        }
+#endif
+        if (xTaskCreatePinnedToCore(gray_task, "gray_task", TASK_STACK_GRAY, NULL,
+                                    GRAY_TASK_PRIO, &gray_task_handle, GRAY_TASK_CORE) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create plane task");
+            esp_timer_delete(slot_timer);
+            return ESP_FAIL;
+        }
+    }
+    // Waking the task cuts the current slot short, so only on a change
+    // (the command is retained and comes again on every reconnect)
+    if (__atomic_exchange_n(&wanted_bits, bits, __ATOMIC_RELAXED) != bits) {
+        xTaskNotifyGive(gray_task_handle);
+    }
+    return ESP_OK;
+}
+
+void gray_get_stats(gray_stats_t *out){
+    *out = stats;  // a torn read only skews one sample of telemetry
+}
+
+// MQTT task
+static void gray_on_command(const mqtt_cmd_t *cmd, const char *data, int len, void *arg){
+    if (len != 1 || cmd->total_len != 1 || data[0] < '0' || data[0] > '9') {
+        return;
+    }
+    if (gray_set_bits(data[0] - '0') != ESP_OK) {
+        DLOGW(TAG, "%c bit-planes not supported", data[0]);
+    }
+}
+
+esp_err_t gray_start(void){
+    return mqtt_register_command("gray", gray_on_command, NULL);
+}
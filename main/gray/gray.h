@@ -0,0 +1,48 @@
+#ifndef GRAY_H
+#define GRAY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Grayscale plane scheduler. The MAX7219 has one intensity per module, so
+// per-LED shading is done in time: with N bits the driver keeps N
+// bit-planes of the frame (see max7219_gray_begin()) and this task latches
+// them one after the other, plane b for 2^b units, one cycle of
+// 2^N - 1 units every GRAY_CYCLE_US. An LED at level q is then lit for
+// q / (2^N - 1) of the time. Widgets with render_levels() (the message
+// zone's anti-aliased scroll) draw in levels while it is on.
+//
+// Switch it with
+//
+//   /classplate/cmd/<device>/gray   "0" (off, default) | "2" | "3"
+//
+// Plane start times come from an absolute schedule (a one-shot esp_timer
+// re-armed for the next slot, not for "now + weight"), so a late wakeup
+// shortens one slot instead of shifting every slot after it. A plane
+// loads in at most 8 chain transactions (about 160 us of bus time at
+// 10 MHz, see display_bench's gray_* cases); the unit must be well above
+// that or the least significant plane comes out too bright. While on, the
+// chip stays out of light sleep (see power.h).
+
+#define GRAY_CYCLE_US   10000  // one pass over all planes, 100 Hz
+#define GRAY_UNIT_MIN_US  1000 // shortest plane slot a mode may use
+#define GRAY_TASK_PRIO      10 // above the display task (6)
+#define GRAY_TASK_CORE       1 // away from Wi-Fi and lwIP on core 0
+
+typedef struct {
+    uint8_t bits;          // 0 while off
+    uint32_t cycles;
+    uint32_t load_avg_us;  // time to latch one plane (1/16 weight)
+    uint32_t load_max_us;
+    uint32_t late_max_us;  // plane latched after its slot began
+    uint32_t overruns;     // slots that were already over when latched
+} gray_stats_t;
+
+// Register the "gray" command; call before mqtt_init(). The task is only
+// created the first time grayscale is switched on.
+esp_err_t gray_start(void);
+// 0 = off, 2 or 3 bit-planes. Safe from any task.
+esp_err_t gray_set_bits(int bits);
+void gray_get_stats(gray_stats_t *stats);
+
+#endif
@@ -4,6 +4,7 @@
 #include "esp_http_client.h"
 
 #include "stdio.h"
+#include <stdbool.h>
 #include "esp_tls.h"
 #include "cJSON.h"
 
@@ -12,6 +13,8 @@
 
 #define MAX_HTTP_RECV_BUFFER 512
 #define MAX_HTTP_OUTPUT_BUFFER 2048
+#define WEATHER_URL "http://weather.indianapi.in/global/current"
+#define MAX_URL_LEN 160
 #define TAG "HTTP_CLIENT"
 
 esp_err_t _http_event_handler(esp_http_client_event_t *evt)
@@ -106,14 +109,54 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
-weather_data_t http_get_weather(void){
-    char local_response_buffer[MAX_HTTP_OUTPUT_BUFFER + 1] = {0};
+// Percent-encode everything but the RFC 3986 unreserved characters.
+// Returns false if it does not fit.
+static bool url_escape(char *out, size_t size, const char *in){
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = 0;
+    for (; *in; in++) {
+        unsigned char c = (unsigned char)*in;
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                     (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~';
+        if (n + (plain ? 1 : 3) >= size) {
+            return false;
+        }
+        if (plain) {
+            out[n++] = c;
+        } else {
+            out[n++] = '%';
+            out[n++] = hex[c >> 4];
+            out[n++] = hex[c & 0x0F];
+        }
+    }
+    out[n] = '\0';
+    return true;
+}
+
+weather_data_t http_get_weather(const char *location){
+    weather_data_t ret_data = {
+        .temp = -1,
+        .wind_speed = -1
+    };
+    char url[MAX_URL_LEN];
+    int prefix = snprintf(url, sizeof(url), WEATHER_URL "?location=");
+    if (!url_escape(url + prefix, sizeof(url) - prefix, location)) {
+        ESP_LOGE(TAG, "Location too long for the URL: %s", location);
+        return ret_data;
+    }
+    // Only the fallback path uses this: keep the 2 KB off the fetch task's
+    // stack and out of RAM between fetches
+    char *local_response_buffer = calloc(1, MAX_HTTP_OUTPUT_BUFFER + 1);
+    if (local_response_buffer == NULL) {
+        ESP_LOGE(TAG, "No memory for the response");
+        return ret_data;
+    }
     esp_http_client_config_t config = {
-        .url = "http://weather.indianapi.in/global/current?location=Jalandhar",
+        .url = url,
         .event_handler = _http_event_handler,
         .user_data = local_response_buffer,
         .disable_auto_redirect = true,
-        .timeout_ms = 30000
+        .timeout_ms = 10000  // bounds how long a dead server keeps the weather task
         //.skip_cert_common_name_check = true,
     };
 
@@ -131,15 +174,12 @@ weather_data_t http_get_weather(void){
         ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
     }
 
-    weather_data_t ret_data = {
-        .temp = -1,
-        .wind_speed = -1
-    };
 
     cJSON *root = cJSON_Parse(local_response_buffer);
     if (!root) {
         ESP_LOGE(TAG, "JSON Parse Error! Raw response: %s", local_response_buffer);
         esp_http_client_cleanup(client);
+        free(local_response_buffer);
         return ret_data;
     }
 
@@ -147,6 +187,7 @@ weather_data_t http_get_weather(void){
         ESP_LOGE(TAG, "JSON is not an object");
         cJSON_Delete(root);
         esp_http_client_cleanup(client);
+        free(local_response_buffer);
         return ret_data;
     }
 
@@ -155,6 +196,7 @@ weather_data_t http_get_weather(void){
         ESP_LOGE(TAG, "JSON array['temperature'] is not a valid number");
         cJSON_Delete(root);
         esp_http_client_cleanup(client);
+        free(local_response_buffer);
         return ret_data;
     }
 
@@ -166,6 +208,7 @@ weather_data_t http_get_weather(void){
         ESP_LOGE(TAG, "JSON array['wind_speed'] is not a valid number");
         cJSON_Delete(root);
         esp_http_client_cleanup(client);
+        free(local_response_buffer);
         return ret_data;
     }
 
@@ -174,6 +217,7 @@ weather_data_t http_get_weather(void){
     // Free JSON tree and client
     cJSON_Delete(root);
     esp_http_client_cleanup(client);
+    free(local_response_buffer);
 
     ret_data.temp = temp;
     ret_data.wind_speed = wind_speed;
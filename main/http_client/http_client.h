@@ -8,6 +8,8 @@ typedef struct _weather_data_t {
     int wind_speed;
 } weather_data_t;
 
-weather_data_t http_get_weather(void);
+// Current weather for location (the same one the server pushes for, see
+// mqtt_location()). temp and wind_speed are -1 on failure.
+weather_data_t http_get_weather(const char *location);
 
 #endif
\ No newline at end of file
@@ -13,10 +13,34 @@
 #include <esp_netif_sntp.h>
 #include "freertos/semphr.h"
 #include "MQTT/MQTT.h"
+#include "marquee/marquee.h"
+#include "font/font.h"
+#include "schedule/schedule.h"
+#include "display/display.h"
+#include "telemetry/telemetry.h"
+#include "telemetry/task_stacks.h"
+#include "dlog/dlog.h"
+#include "clock/clock.h"
+#include "widget/widget.h"
+#include "message/message.h"
+#include "app_loop/app_loop.h"
+#include "trace/trace.h"
+#include "scroll_sync/scroll_sync.h"
+#include "canned/canned.h"
+#include "gray/gray.h"
+#include "power/power.h"
+#include "esp_timer.h"
 
 #include <string.h>
 #include <ctype.h>
 
+#define MSG_SCROLL_MS 80  // marquee speed, one column per step
+#define WEATHER_PERIOD_MS  600000  // 10 min
+#define WEATHER_RETRY_MS    60000
+#define WEATHER_FIRST_MS    15000  // grace for the retained push after boot
+#define WEATHER_STALE_S      1800  // pushes older than this don't count
+#define WEATHER_SKEW_S        300  // nor pushes from further in the future
+
 SemaphoreHandle_t mqtt_mutex;
 
 static void init_nvs_netif(void){
@@ -57,43 +81,89 @@ static void init_ntp(void){
     ESP_LOGI("TIME", "The updated current time is: %s", asctime(&timeinfo));
 }
 
-static void push_col(uint8_t buf[32], uint8_t col, int buflen){
-    // For each of the 8 rows (top to bottom)
-    for (int row = 0; row < 8; row++)
-    {
-        // Compute the 4 module row indices
-        int i0 = row;        // module 4
-        int i1 = 8 + row;    // module 5
-        int i2 = 16 + row;   // module 6
-        int i3 = 24 + row;   // module 7
-
-        // Save MSB bits for cascading
-        uint8_t msb0 = (buf[i0] & 0x80) >> 7;
-        uint8_t msb1 = (buf[i1] & 0x80) >> 7;
-        uint8_t msb2 = (buf[i2] & 0x80) >> 7;
-
-        // 1) Shift LEFT module 4 and take MSB from module 5
-        buf[i0] <<= 1;
-        buf[i0] |= msb1;
-
-        // 2) Shift LEFT module 5 and take MSB from module 6
-        buf[i1] <<= 1;
-        buf[i1] |= msb2;
-
-        // 3) Shift LEFT module 6 and take MSB from module 7
-        uint8_t msb3 = (buf[i3] & 0x80) >> 7;
-        buf[i2] <<= 1;
-        buf[i2] |= msb3;
-
-        // 4) Shift LEFT module 7 and insert NEW COLUMN BIT
-        buf[i3] <<= 1;
-        uint8_t new_bit = (col >> row) & 1;
-        buf[i3] |= new_bit;
+// Message zone (modules 8..11): one marquee column every MSG_SCROLL_MS,
+// or wherever the wall's clock says when scrolling in sync with other
+// signs (scroll_sync.h). In grayscale the free-running scroll is drawn
+// MARQUEE_SUBSTEPS times per column, gliding between columns.
+static marquee_t mq;
+static int64_t mq_pass = -2;  // synced: pass shown, -1 before the epoch
+static int mq_sub;            // grayscale: views shown since the last step
+static uint8_t mq_next[MARQUEE_BUF_LEN];  // the view after the next step
+static widget_t msg_widget;
+
+// Anything for msg_take_pending(), looked at without the mutex
+static bool msg_pending(void){
+    return message_pending() || canned_pending() || mqtt_data_update;
+}
+
+static void msg_show_text(const char *text, int len){
+    marquee_set_text(&mq, text, len);
+    mq_sub = 0;
+    canned_hide();
+}
+
+static void msg_show_cols(const uint8_t *cols, int n){
+    marquee_set_cols(&mq, cols, n);
+    mq_sub = 0;
+    message_hide();
+}
+
+// Take a new message or intensity. Never blocks the frame on the MQTT
+// task: false if it is busy, try again next time.
+static bool msg_take_pending(void){
+    if (xSemaphoreTake(mqtt_mutex, 0) != pdTRUE) {
+        TRACE_INSTANT(TRACE_MUTEX_BUSY, 0);
+        return false;
     }
+    const char *text;
+    int len;
+    int64_t text_at;
+    bool new_text = message_take(&text, &len, &text_at);
+    if(mqtt_data_update){
+        set_all_brightness(mqtt_msg.intensity);
+        mqtt_data_update = false;
+    }
+    DLOGV("DISPLAY", "intensity: %d", mqtt_msg.intensity);
+    xSemaphoreGive(mqtt_mutex);
+
+    const uint8_t *cols;
+    int n;
+    int64_t cols_at;
+    bool new_cols = canned_take(&cols, &n, &cols_at);
+
+    // Both came in since the last step: apply the older first, so the
+    // command sent last is the one left on the sign
+    if (new_text && new_cols && text_at > cols_at) {
+        msg_show_cols(cols, n);
+        msg_show_text(text, len);
+    } else {
+        if (new_text) {
+            msg_show_text(text, len);
+        }
+        if (new_cols) {
+            msg_show_cols(cols, n);
+        }
+    }
+    return true;
+}
+
+static int64_t msg_pass_of(int64_t col){
+    return col < 0 ? -1 : col / marquee_cycle(&mq);
 }
 
+static bool msg_update_synced(int64_t col){
+    // A pass ends at the same stream column on every sign, so a message
+    // that reached the whole wall switches over seamlessly
+    if (msg_pass_of(col) != mq_pass) {
+        if (!msg_take_pending()) {
+            return false;
+        }
+        mq_pass = msg_pass_of(col);
+    }
+    return marquee_seek(&mq, col);
+}
 
-static void display_msg_task(void *pvParameters){
+static bool msg_update(widget_t *w){
     // if msg not overflowed -> showed it statically
         // if msg overflowed -> then
             // Algorithim 01:
@@ -120,111 +190,242 @@ static void display_msg_task(void *pvParameters){
                         // Now push blank 8x16 blank data into buf, to flush the text out
                         // continuing update buf similary
 
-    char *msg = mqtt_msg.msg;
-    int msglen = strlen(msg);
-    int speed = 80;                    
-    uint8_t buf[32] = {0};
-    
-    while (1) {
-        // Check for any update in mqtt_msg and then proceed
-        xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
-        if(mqtt_data_update){
-            set_all_brightness(mqtt_msg.intensity);
-            strncpy(msg, mqtt_msg.msg, strlen(mqtt_msg.msg));
-            // strcpy(local_msg_buffer, mqtt_msg.msg);
-            // msg = local_msg_buffer;
-            msglen = strlen(msg);
-            mqtt_data_update = false;
-        }
-        // draw charcters on buf, and then shift it
-        printf("---> intensity: %d", mqtt_msg.intensity);
-        xSemaphoreGive(mqtt_mutex);
-
-        for(int i = 0; i<msglen; i++){
-            char c = msg[i];
-            uint8_t cbuf[5];
-            printf("--> %c\n", c);
-            if(c == ' ') memcpy(cbuf, string_font6x5[26].rows, 5);
-            else if(c == '!') memcpy(cbuf, string_font6x5[27].rows, 5);
-            else if(c == '.') memcpy(cbuf, string_font6x5[28].rows, 5);
-            else memcpy(cbuf, string_font6x5[c - 'A'].rows, 5);
-
-            for(int col = 0; col<5; col++){
-                push_col(buf, cbuf[col], 32);
-                draw_buffer(buf);
-                vTaskDelay(pdMS_TO_TICKS(speed));
-            }
-            // push 2 blank space
-            for(int _ = 0; _< 2; _++){
-                push_col(buf, 0b00000000, 32);
-                draw_buffer(buf);
-                vTaskDelay(pdMS_TO_TICKS(speed));
-            }
-        }
-        
-        // as we reahced to the end of msg, insert 16 blank spaces in between
-        for(int _ = 0; _< 16; _++){
-            push_col(buf, 0b00000000, 32);
-            draw_buffer(buf);
-            vTaskDelay(pdMS_TO_TICKS(speed));
+    bool smooth = max7219_gray_bits() > 0;
+    w->period_ms = smooth ? MSG_SCROLL_MS / MARQUEE_SUBSTEPS : MSG_SCROLL_MS;
+
+    int64_t col;
+    if (scroll_sync_column(&col)) {
+        mq_sub = 0;  // the wall steps whole columns
+        return msg_update_synced(col);
+    }
+    mq_pass = -2;
+
+    // Free running, a new message replaces the current one at the next
+    // step, mid-pass or not: the message buffers are swapped, so the text
+    // being scrolled is never written under the marquee
+    if (msg_pending() && !msg_take_pending()) {
+        return false;
+    }
+
+    if (smooth && mq_sub + 1 < MARQUEE_SUBSTEPS) {
+        if (mq_sub++ == 0) {
+            marquee_peek(&mq, mq_next);
         }
+        return true;
+    }
+    mq_sub = 0;
+
+    // draw charcters on buf, and then shift it
+    if(mq.text != NULL && mq.col == 0 && mq.chr < mq.len){
+        DLOGV("DISPLAY", "--> %c", mq.text[mq.chr]); // lead byte only for non-ASCII
+    }
+    marquee_step(&mq);
+    return true;
+}
+
+static void msg_render(widget_t *w, uint8_t *rows){
+    memcpy(rows, mq.buf, MARQUEE_BUF_LEN);
+}
+
+static void msg_render_levels(widget_t *w, uint8_t *levels){
+    marquee_levels(mq.buf, mq_next, mq_sub, levels);
+}
+
+// Weather zone (modules 0..3), redrawn only when a fetch brings new data.
+static weather_data_t weather_latest;
+static weather_data_t weather_shown;
+static bool weather_valid;
+static portMUX_TYPE weather_lock = portMUX_INITIALIZER_UNLOCKED;
+static widget_t weather_widget;
+
+static bool weather_update(widget_t *w){
+    portENTER_CRITICAL(&weather_lock);
+    bool valid = weather_valid;
+    weather_shown = weather_latest;
+    portEXIT_CRITICAL(&weather_lock);
+    return valid;  // keep the boot screen until the first fetch
+}
+
+static void weather_render(widget_t *w, uint8_t *rows){
+    render_weather(weather_shown, (uint8_t (*)[8])rows);
+}
+
+static void start_widgets(void){
+    // Scroll the default text until a message comes in
+    const char *text = "";
+    int len = 0;
+    message_init(MESSAGE_DEFAULT);
+    message_take(&text, &len, NULL);
+    marquee_init(&mq, text, len);
+    msg_widget = (widget_t){
+        .name = "message", .first_module = 8, .num_modules = 4,
+        .period_ms = MSG_SCROLL_MS, .update = msg_update, .render = msg_render,
+        .render_levels = msg_render_levels,
+    };
+    weather_widget = (widget_t){
+        .name = "weather", .first_module = 0, .num_modules = 4,
+        .update = weather_update, .render = weather_render,
+    };
+    widget_start();
+    widget_add(&msg_widget);
+    widget_add(&weather_widget);
+}
+
+// Weather: the server fetches it once per location and pushes it over
+// MQTT (see mqtt_topics.h). The HTTP fetch is only the fallback: the
+// timer looks every WEATHER_PERIOD_MS and fetches when no push younger
+// than WEATHER_STALE_S came in. The fetch blocks on the network for up
+// to the client's timeout, so it runs on its own task; the app loop only
+// wakes it. While the network is down the timer is stopped; it restarts
+// when the network is back, at once if the last fetch had failed.
+static esp_timer_handle_t weather_timer;
+static TaskHandle_t weather_task_handle;
+static bool weather_failed;      // last fetch failed, written by the weather task
+static bool weather_net_down;    // written by the app loop
+static uint32_t weather_pushed;  // Unix time the pushed data was fetched, 0 if none
+
+// False if the zone cannot show it
+static bool weather_show(weather_data_t weather_data){
+    // Two digits each, see render_weather()
+    if(weather_data.temp >0 && weather_data.temp <= MQTT_WEATHER_MAX &&
+       weather_data.wind_speed>=0 && weather_data.wind_speed <= MQTT_WEATHER_MAX){
+        // TODO : Handle -ve temperature
+        portENTER_CRITICAL(&weather_lock);
+        weather_latest = weather_data;
+        weather_valid = true;
+        portEXIT_CRITICAL(&weather_lock);
+        widget_invalidate(&weather_widget);
+        return true;
     }
+    return false;
 }
 
+static int64_t weather_age_s(uint32_t fetched){
+    return (int64_t)time(NULL) - fetched;
+}
 
-void display_time_task(void *pvParameters){
-    int hr = 0; 
-    int min = 0;
-    int sec = 0;
+static bool weather_push_fresh(void){
+    uint32_t fetched = __atomic_load_n(&weather_pushed, __ATOMIC_RELAXED);
+    int64_t age = weather_age_s(fetched);
+    return fetched != 0 && age < WEATHER_STALE_S && age >= -WEATHER_SKEW_S;
+}
 
-    while(1){
-        time_t now;
-        struct tm timeinfo;
+// MQTT task
+static void weather_on_push(const mqtt_weather_t *weather){
+    int64_t age = weather_age_s(weather->fetched);
+    if (age >= WEATHER_STALE_S || age < -WEATHER_SKEW_S) {
+        DLOGW("WEATHER", "pushed weather is %lld s old, ignored", (long long)age);
+        return;
+    }
+    DLOGI("WEATHER", "pushed: %d C, wind %d", weather->temp, weather->wind_speed);
+    // Only a push on the sign holds off the HTTP fallback
+    if (!weather_show((weather_data_t){.temp = weather->temp, .wind_speed = weather->wind_speed})) {
+        DLOGW("WEATHER", "pushed weather not shown");
+        return;
+    }
+    __atomic_store_n(&weather_pushed, weather->fetched, __ATOMIC_RELAXED);
+}
+
+static void weather_timer_cb(void *arg){
+    app_loop_post(APP_EVT_WEATHER_DUE, 0);
+}
+
+static void weather_rearm(uint32_t ms){
+    esp_timer_stop(weather_timer);
+    esp_timer_start_once(weather_timer, (uint64_t)ms * 1000);
+}
 
-        time(&now);
-        localtime_r(&now, &timeinfo);
+static void weather_fetch(void){
+    if (weather_push_fresh()) {
+        __atomic_store_n(&weather_failed, false, __ATOMIC_RELAXED);
+        weather_rearm(WEATHER_PERIOD_MS);
+        return;
+    }
 
-        hr   = timeinfo.tm_hour; 
-        min = timeinfo.tm_min;  
-        sec = timeinfo.tm_sec;    
-        draw_time(hr, min, sec);
-        vTaskDelay(pdMS_TO_TICKS(1000));
+    TRACE_BEGIN(TRACE_HTTP_FETCH, 0);
+    weather_data_t weather_data = http_get_weather(mqtt_location());
+    TRACE_END(TRACE_HTTP_FETCH, weather_data.temp != -1);
+    bool failed = weather_data.temp == -1 || weather_data.wind_speed == -1;
+    __atomic_store_n(&weather_failed, failed, __ATOMIC_RELAXED);
+    if(failed){
+        ESP_LOGE("HTTP", "Failed to get weather data");
+    }else{
+        ESP_LOGI("HTTP","GET Temp : %d, Wind Speed : %d (no push from the server)",
+                 weather_data.temp, weather_data.wind_speed);
+        weather_show(weather_data);
     }
+    if (failed && __atomic_load_n(&weather_net_down, __ATOMIC_RELAXED)) {
+        return;  // offline: weather_net_up() starts over
+    }
+    weather_rearm(failed ? WEATHER_RETRY_MS : WEATHER_PERIOD_MS);
 }
 
-void display_weather_task(void *pvParameters){
-    weather_data_t weather_data;
-    while(1){
-        weather_data = http_get_weather();
-        if(weather_data.temp != -1){
-            ESP_LOGI("HTTP","GET Temp : %d\n", weather_data.temp);
-        }else{
-            ESP_LOGE("HTTP", "Failed to get weather data");
-            continue;
-        }
-        if(weather_data.wind_speed != -1){
-            ESP_LOGI("HTTP","GET Wind Speed : %d\n", weather_data.wind_speed);
-        }else{
-            ESP_LOGE("HTTP", "Failed to get weather data");
-            continue;
-        }
+static void weather_task(void *pvParameters){
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        weather_fetch();
+    }
+}
 
-        if(weather_data.temp >0 && weather_data.wind_speed>=0){
-            // TODO : Handle -ve temperature
-            draw_weather(weather_data);
-        }
-        vTaskDelay(pdMS_TO_TICKS(600000)); // 10 min
+static void weather_due(const app_event_t *event, void *arg){
+    xTaskNotifyGive(weather_task_handle);
+}
+
+static void weather_net_up(const app_event_t *event, void *arg){
+    if (!__atomic_exchange_n(&weather_net_down, false, __ATOMIC_RELAXED)) {
+        return;
+    }
+    if (__atomic_load_n(&weather_failed, __ATOMIC_RELAXED)) {
+        xTaskNotifyGive(weather_task_handle);  // don't wait for the retry
+    } else {
+        weather_rearm(WEATHER_FIRST_MS);  // the retained push comes with the reconnect
+    }
+}
+
+static void weather_net_down_cb(const app_event_t *event, void *arg){
+    // Fetching without a network only fails; hold off until it is back
+    __atomic_store_n(&weather_net_down, true, __ATOMIC_RELAXED);
+    esp_timer_stop(weather_timer);
+}
+
+// Before mqtt_init(), which delivers the pushes
+static void start_weather(void){
+    const esp_timer_create_args_t args = {
+        .callback = weather_timer_cb,
+        .name = "weather",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &weather_timer));
+    mqtt_on_weather(weather_on_push);
+    if (xTaskCreate(weather_task, "weather", TASK_STACK_WEATHER, NULL, 4, &weather_task_handle) != pdPASS) {
+        ESP_LOGE("WEATHER", "Failed to create the fetch task, pushes only");
+        return;
     }
+    app_loop_register(APP_EVT_WEATHER_DUE, weather_due, NULL);
+    app_loop_register(APP_EVT_NET_UP, weather_net_up, NULL);
+    app_loop_register(APP_EVT_NET_DOWN, weather_net_down_cb, NULL);
+    // The retained push normally arrives right after connecting
+    weather_rearm(WEATHER_FIRST_MS);
 }
 
 static void engine_task(void *pvParameters){
+    // Console output of the hot paths goes through the deferred log
+    dlog_init();
+    // Timers, Wi-Fi and MQTT post here; handled once boot is done
+    app_loop_init();
+    // DFS and automatic light sleep, before Wi-Fi starts
+    power_init();
     // init Network interface
     init_nvs_netif();
+    // Night dimming/off windows stored in NVS
+    schedule_init();
     // init SPI for MAX7219
     init_spi();
+    // Message font from the "font" partition, falls back to the built-in A-Z
+    font_init();
     // Draw on Display
     set_all_brightness(0x00); // 0x00 -> MIN, 0x0F -> MAX, 0x08 -> 50%
     draw_init();
+    max7219_commit();
 
     // init WiFi
     if(wifi_init_sta() != ESP_OK){
@@ -233,24 +434,33 @@ static void engine_task(void *pvParameters){
     
     ESP_LOGI("DISPLAY", "Starting display...");
     
-    xTaskCreate(display_msg_task, "display_msg_task", 6144, NULL, 5, NULL);
+    start_widgets();
+    display_start();
     init_ntp();
 
-    xTaskCreate(display_time_task, "display_time_task", 4096, NULL, 5, NULL);
-    xTaskCreate(display_weather_task, "display_weather_task", 6144, NULL, 5, NULL);
+    clock_start();
+    start_weather();
 
+    // These register MQTT commands, so before mqtt_init(). A command that
+    // does not fit the router is a build mistake, so stop here.
+    ESP_ERROR_CHECK(trace_start());
+    ESP_ERROR_CHECK(scroll_sync_start(&msg_widget));
+    ESP_ERROR_CHECK(canned_start());
+    ESP_ERROR_CHECK(gray_start());
     if(mqtt_init() != ESP_OK){
         ESP_LOGE("MQTT", "Failed to initilize.");
     }
+    telemetry_start();
 
-    while(1){
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
+    // From here on this task is the app loop
+    ESP_LOGI("MAIN", "Boot done, engine_task stack left: %u bytes",
+             (unsigned)uxTaskGetStackHighWaterMark(NULL));
+    app_loop_run();
 }
 
 void app_main(void){
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     mqtt_mutex = xSemaphoreCreateMutex();
-    xTaskCreate(engine_task, "engine_task", 8192, NULL, 5, NULL);
+    xTaskCreate(engine_task, "engine_task", TASK_STACK_ENGINE, NULL, 5, NULL);
     vTaskDelay(pdMS_TO_TICKS(10));
 }
\ No newline at end of file
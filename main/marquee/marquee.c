@@ -0,0 +1,195 @@
+#include "marquee.h"
+#include <string.h>
+
+void push_col(uint8_t buf[MARQUEE_BUF_LEN], uint8_t col){
+    // For each of the 8 rows (top to bottom)
+    for (int row = 0; row < 8; row++)
+    {
+        // Compute the 4 module row indices
+        int i0 = row;        // module 4
+        int i1 = 8 + row;    // module 5
+        int i2 = 16 + row;   // module 6
+        int i3 = 24 + row;   // module 7
+
+        // Save MSB bits for cascading
+        uint8_t msb1 = (buf[i1] & 0x80) >> 7;
+        uint8_t msb2 = (buf[i2] & 0x80) >> 7;
+
+        // 1) Shift LEFT module 4 and take MSB from module 5
+        buf[i0] <<= 1;
+        buf[i0] |= msb1;
+
+        // 2) Shift LEFT module 5 and take MSB from module 6
+        buf[i1] <<= 1;
+        buf[i1] |= msb2;
+
+        // 3) Shift LEFT module 6 and take MSB from module 7
+        uint8_t msb3 = (buf[i3] & 0x80) >> 7;
+        buf[i2] <<= 1;
+        buf[i2] |= msb3;
+
+        // 4) Shift LEFT module 7 and insert NEW COLUMN BIT
+        buf[i3] <<= 1;
+        uint8_t new_bit = (col >> row) & 1;
+        buf[i3] |= new_bit;
+    }
+}
+
+void marquee_set_text(marquee_t *mq, const char *text, int len){
+    mq->text = text;
+    mq->cols = NULL;
+    mq->len = len;
+    mq->chr = 0;
+    mq->used = 0;
+    mq->col = 0;
+    mq->tail = 0;
+    mq->pos = -1;
+    mq->cycle = 0;
+}
+
+void marquee_set_cols(marquee_t *mq, const uint8_t *cols, int n){
+    marquee_set_text(mq, NULL, n);
+    mq->cols = cols;
+}
+
+void marquee_init(marquee_t *mq, const char *text, int len){
+    memset(mq->buf, 0, sizeof(mq->buf));
+    marquee_set_text(mq, text, len);
+}
+
+// Feed the column after the current one; true when it ended a pass.
+static bool feed_col(marquee_t *mq){
+    if(mq->chr < mq->len){
+        if(mq->cols != NULL){
+            push_col(mq->buf, mq->cols[mq->chr++]);
+            return false;
+        }
+        if(mq->col == 0){
+            uint32_t cp = font_utf8_next(mq->text + mq->chr, mq->len - mq->chr, &mq->used);
+            mq->glyph = *font_glyph(cp);
+        }
+        uint8_t col = 0;
+        if(mq->col < mq->glyph.width){
+            col = mq->glyph.cols[mq->col];
+        }
+        push_col(mq->buf, col);
+        if(++mq->col >= mq->glyph.width + MARQUEE_GAP_COLS){
+            mq->col = 0;
+            mq->chr += mq->used;
+        }
+        return false;
+    }
+
+    // as we reached the end of msg, insert blank columns in between
+    push_col(mq->buf, 0b00000000);
+    if(++mq->tail >= MARQUEE_TAIL_COLS){
+        mq->chr = 0;
+        mq->col = 0;
+        mq->tail = 0;
+        return true;
+    }
+    return false;
+}
+
+bool marquee_step(marquee_t *mq){
+    mq->pos++;
+    return feed_col(mq);
+}
+
+// Put the feed position on column col of a pass (0 <= col < cycle)
+// without pushing anything.
+static void locate(marquee_t *mq, int col){
+    mq->chr = 0;
+    mq->col = 0;
+    mq->tail = 0;
+    if(mq->cols != NULL){
+        mq->chr = col < mq->len ? col : mq->len;
+        mq->tail = col - mq->chr;
+        return;
+    }
+    while(mq->chr < mq->len){
+        uint32_t cp = font_utf8_next(mq->text + mq->chr, mq->len - mq->chr, &mq->used);
+        mq->glyph = *font_glyph(cp);
+        int width = mq->glyph.width + MARQUEE_GAP_COLS;
+        if(col < width){
+            mq->col = col;
+            return;
+        }
+        col -= width;
+        mq->chr += mq->used;
+    }
+    mq->tail = col;
+}
+
+// cached: through the glyph cache, display task only
+static int render(const char *text, int len, uint8_t *out, bool cached){
+    int n = 0;
+    int used;
+    font_glyph_t read;
+    for(int chr = 0; chr < len; chr += used){
+        uint32_t cp = font_utf8_next(text + chr, len - chr, &used);
+        const font_glyph_t *glyph = &read;
+        if(cached){
+            glyph = font_glyph(cp);
+        }else{
+            font_glyph_read(cp, &read);
+        }
+        if(out != NULL){
+            memcpy(out + n, glyph->cols, glyph->width);
+            memset(out + n + glyph->width, 0, MARQUEE_GAP_COLS);
+        }
+        n += glyph->width + MARQUEE_GAP_COLS;
+    }
+    return n;
+}
+
+int marquee_render(const char *text, int len, uint8_t *out){
+    return render(text, len, out, false);
+}
+
+int marquee_cycle(marquee_t *mq){
+    if(mq->cycle == 0){
+        int cols = mq->cols != NULL ? mq->len : render(mq->text, mq->len, NULL, true);
+        mq->cycle = cols + MARQUEE_TAIL_COLS;
+    }
+    return mq->cycle;
+}
+
+bool marquee_seek(marquee_t *mq, int64_t col){
+    if(col == mq->pos){
+        return false;
+    }
+    if(col != mq->pos + 1){
+        memset(mq->buf, 0, sizeof(mq->buf));
+        int64_t first = col - (MARQUEE_COLS - 1);
+        locate(mq, first > 0 ? (int)(first % marquee_cycle(mq)) : 0);
+        mq->pos = first - 1;
+    }
+    while(mq->pos < col){
+        if(++mq->pos < 0){
+            push_col(mq->buf, 0);  // before the stream starts
+        }else{
+            feed_col(mq);
+        }
+    }
+    return true;
+}
+
+void marquee_peek(const marquee_t *mq, uint8_t next[MARQUEE_BUF_LEN]){
+    marquee_t ahead = *mq;  // the text is only read
+    marquee_step(&ahead);
+    memcpy(next, ahead.buf, MARQUEE_BUF_LEN);
+}
+
+void marquee_levels(const uint8_t buf[MARQUEE_BUF_LEN], const uint8_t next[MARQUEE_BUF_LEN],
+                    int sub, uint8_t *levels){
+    for(int i = 0; i < MARQUEE_BUF_LEN; i++){
+        for(int col = 0; col < 8; col++){
+            int level = ((buf[i] << col) & 0x80) ? 255 * (MARQUEE_SUBSTEPS - sub) : 0;
+            if((next[i] << col) & 0x80){
+                level += 255 * sub;
+            }
+            levels[i * 8 + col] = (uint8_t)(level / MARQUEE_SUBSTEPS);
+        }
+    }
+}
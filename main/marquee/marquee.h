@@ -0,0 +1,73 @@
+#ifndef MARQUEE_H
+#define MARQUEE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../font/font.h"
+
+#define MARQUEE_BUF_LEN   32  // 4 modules x 8 rows
+#define MARQUEE_COLS      32  // columns in view
+#define MARQUEE_GAP_COLS   2  // blank columns after every glyph
+#define MARQUEE_TAIL_COLS  16 // blank columns after the whole text
+#define MARQUEE_SUBSTEPS    4 // grayscale: views per column, see marquee_levels()
+
+// Text scroller for the message zone (modules 8..11).
+// Every marquee_step() shifts buf one column to the left and feeds in the
+// next column of the text, so the caller only has to draw buf and wait.
+// text is UTF-8 and read in place, one glyph ahead of the window; glyphs
+// are looked up once per character, not per column. It is not copied, so
+// it must stay valid until the next marquee_set_text().
+//
+// The text repeats as a stream of columns: column 0 is its first column,
+// one pass is marquee_cycle() columns (text, gaps and tail), and columns
+// before 0 are blank. marquee_seek() shows the view whose rightmost
+// column is a given stream column, so signs that derive the column from
+// a shared clock show the same scroll without talking to each other.
+//
+// Instead of text the marquee can scroll columns rendered beforehand with
+// marquee_render(); then a step is one byte copy and no glyph lookup.
+typedef struct {
+    const char *text;
+    const uint8_t *cols;  // pre-rendered columns instead of text, or NULL
+    int len;   // bytes of text, or columns
+    int chr;   // byte offset of the glyph being fed in, or column
+    int used;  // its UTF-8 length
+    int col;   // column of that glyph, glyph.width.. are the gap
+    int tail;  // blank columns fed after the last glyph
+    int64_t pos;  // stream column at the right edge, -1 before the first step
+    int cycle;    // columns per pass, 0 until marquee_cycle() counted them
+    font_glyph_t glyph;
+    uint8_t buf[MARQUEE_BUF_LEN];
+} marquee_t;
+
+void marquee_init(marquee_t *mq, const char *text, int len);
+void marquee_set_text(marquee_t *mq, const char *text, int len);
+// Scroll n columns from marquee_render(), which must stay valid until
+// the next marquee_set_*().
+void marquee_set_cols(marquee_t *mq, const uint8_t *cols, int n);
+// The columns text scrolls as, gaps included and the tail not. Returns
+// how many there are; with out NULL it only counts them. Does not use the
+// glyph cache, so any task may render.
+int marquee_render(const char *text, int len, uint8_t *out);
+// Returns true when this step finished a full pass (text + tail).
+bool marquee_step(marquee_t *mq);
+// Columns per pass. Walks the whole text once per marquee_set_text().
+int marquee_cycle(marquee_t *mq);
+// Show stream column col at the right edge. The next column costs one
+// step; any other jump refills the view, skipping whole glyphs on the way.
+// Returns false if col is already shown.
+bool marquee_seek(marquee_t *mq, int64_t col);
+
+// Anti-aliased scrolling for grayscale. marquee_peek() gives the view the
+// next marquee_step() will show, without stepping. marquee_levels() fills
+// levels (MARQUEE_BUF_LEN * 8 of them, laid out for draw_zone_levels())
+// with the view `sub` MARQUEE_SUBSTEPS of the way from buf to next: each
+// LED gets the share of that sub-column interval its text pixel covers,
+// so the text glides instead of jumping a whole column.
+void marquee_peek(const marquee_t *mq, uint8_t next[MARQUEE_BUF_LEN]);
+void marquee_levels(const uint8_t buf[MARQUEE_BUF_LEN], const uint8_t next[MARQUEE_BUF_LEN],
+                    int sub, uint8_t *levels);
+
+void push_col(uint8_t buf[MARQUEE_BUF_LEN], uint8_t col);
+
+#endif
@@ -0,0 +1,115 @@
+#include "message.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <string.h>
+
+#define TAG "MESSAGE"
+
+static char *bufs[2];
+static int lens[2];
+static int64_t handed_at[2];
+static int capacity;
+static int shown = 1;      // reader side; bufs[shown] is on the display
+static int pending = -1;   // buffer to switch to at the next take, -1 if none
+static int target;         // writer side, buffer being filled
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t message_init(const char *text){
+    capacity = MESSAGE_TEXT_MAX;
+    bufs[0] = heap_caps_malloc(2 * capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (bufs[0] == NULL) {
+        capacity = MESSAGE_TEXT_MAX_INTERNAL;
+        bufs[0] = heap_caps_malloc(2 * capacity, MALLOC_CAP_8BIT);
+        if (bufs[0] == NULL) {
+            ESP_LOGE(TAG, "No memory for message buffers");
+            return ESP_ERR_NO_MEM;
+        }
+        ESP_LOGW(TAG, "No PSRAM, messages limited to %d bytes", capacity);
+    }
+    bufs[1] = bufs[0] + capacity;
+
+    int len = strlen(text);
+    message_write(0, text, len, len);
+    return ESP_OK;
+}
+
+int message_capacity(void){
+    return capacity;
+}
+
+void message_write(int offset, const char *data, int len, int total_len){
+    if (bufs[0] == NULL) {
+        return;
+    }
+    if (offset == 0) {
+        // The reader never looks at the other buffer until it is pending
+        portENTER_CRITICAL(&lock);
+        target = shown ^ 1;
+        pending = -1;
+        portEXIT_CRITICAL(&lock);
+    }
+    if (offset < capacity) {
+        memcpy(bufs[target] + offset, data, len < capacity - offset ? len : capacity - offset);
+    }
+    if (offset + len < total_len) {
+        return;
+    }
+
+    int size = total_len;
+    if (size > capacity) {
+        ESP_LOGW(TAG, "Message of %d bytes cut to %d", size, capacity);
+        size = capacity;
+        // Don't leave half a UTF-8 sequence at the end
+        const unsigned char *text = (const unsigned char *)bufs[target];
+        int lead = size - 1;
+        while (lead > 0 && (text[lead] & 0xC0) == 0x80) {
+            lead--;
+        }
+        int need = text[lead] >= 0xF0 ? 4 : text[lead] >= 0xE0 ? 3 : text[lead] >= 0xC0 ? 2 : 1;
+        if (lead + need > size) {
+            size = lead;
+        }
+    }
+    // shown only changes while something is pending, so it is stable here
+    bool same = size == lens[shown] && memcmp(bufs[target], bufs[shown], size) == 0;
+    lens[target] = size;
+    if (!same) {
+        handed_at[target] = esp_timer_get_time();
+        portENTER_CRITICAL(&lock);
+        pending = target;
+        portEXIT_CRITICAL(&lock);
+    }
+}
+
+void message_hide(void){
+    portENTER_CRITICAL(&lock);
+    lens[shown] = -1;  // matches no message
+    portEXIT_CRITICAL(&lock);
+}
+
+bool message_pending(void){
+    return __atomic_load_n(&pending, __ATOMIC_RELAXED) >= 0;
+}
+
+bool message_take(const char **text, int *len, int64_t *at){
+    bool taken = false;
+    portENTER_CRITICAL(&lock);
+    if (pending >= 0) {
+        shown = pending;
+        pending = -1;
+        taken = true;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (taken) {
+        *text = bufs[shown];
+        *len = lens[shown];
+        if (at != NULL) {
+            *at = handed_at[shown];
+        }
+    }
+    return taken;
+}
@@ -0,0 +1,47 @@
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// The text behind the message zone.
+//
+// Two buffers of MESSAGE_TEXT_MAX bytes are taken from PSRAM once at boot
+// (internal RAM, MESSAGE_TEXT_MAX_INTERNAL each, on boards without it):
+// one is shown, the other receives the next message. The marquee reads
+// the shown one in place, a glyph at a time, so a long announcement costs
+// no extra RAM and starts scrolling as soon as its last byte arrived.
+//
+// One writer (the MQTT task) and one reader (the display task).
+
+#define MESSAGE_TEXT_MAX           8192
+#define MESSAGE_TEXT_MAX_INTERNAL  1024
+#define MESSAGE_DEFAULT            "HELLO LPU! WE ARE CIRCUIT CRAFTERS."
+
+// Allocate the buffers and queue text as the first message.
+esp_err_t message_init(const char *text);
+
+// Writer: bytes offset .. offset + len of a total_len byte message, in
+// order. Whatever does not fit is cut. The message is handed over once the
+// last chunk is in, unless it is the one already shown.
+void message_write(int offset, const char *data, int len, int total_len);
+
+// Reader: true if a message waits for message_take(). No lock, cheap
+// enough to ask every frame.
+bool message_pending(void);
+
+// Reader: if a new message was handed over, make it the shown one and
+// return true with its text (not NUL terminated) and, if at is not NULL,
+// when it was handed over (esp_timer time). The previous text must not
+// be used after this.
+bool message_take(const char **text, int *len, int64_t *at);
+
+// Reader: the shown text left the screen (a canned message replaced it),
+// so the same text sent again is a new message.
+void message_hide(void);
+
+// Bytes a message may have on this board.
+int message_capacity(void);
+
+#endif
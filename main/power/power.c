@@ -0,0 +1,90 @@
+#include "power.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#define TAG "POWER"
+
+// Kept by the wake callback
+static uint32_t sleeps;
+static uint64_t slept_us;
+
+// At the previous power_sample()
+static int64_t last_us;
+static uint32_t last_sleeps;
+static uint64_t last_slept_us;
+static uint32_t last_idle[2];
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+// Runs from the idle task on the way out of every light sleep, with the
+// scheduler still stopped: count and nothing else.
+static IRAM_ATTR esp_err_t power_on_wake(int64_t sleep_time_us, void *arg){
+    sleeps++;
+    slept_us += sleep_time_us;
+    return ESP_OK;
+}
+#endif
+
+esp_err_t power_init(void){
+    last_us = esp_timer_get_time();
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = POWER_CPU_MIN_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t ret = esp_pm_configure(&pm);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure power management (%s)", esp_err_to_name(ret));
+        return ret;
+    }
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    esp_pm_sleep_cbs_register_config_t cbs = {
+        .exit_cb = power_on_wake,
+    };
+    ret = esp_pm_light_sleep_register_cbs(&cbs);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "No light sleep counters (%s)", esp_err_to_name(ret));
+    }
+#endif
+    ESP_LOGI(TAG, "%d..%d MHz, light sleep %s", pm.min_freq_mhz, pm.max_freq_mhz,
+             pm.light_sleep_enable ? "on" : "off");
+#else
+    ESP_LOGW(TAG, "Built without CONFIG_PM_ENABLE, running at full clock");
+#endif
+    return ESP_OK;
+}
+
+void power_sample(power_sample_t *out){
+    int64_t now = esp_timer_get_time();
+    uint64_t window_us = now > last_us ? (uint64_t)(now - last_us) : 0;
+    // Torn reads of the counters only skew one sample of telemetry
+    uint32_t n = sleeps;
+    uint64_t us = slept_us;
+
+    out->window_ms = (uint32_t)(window_us / 1000);
+    out->sleeps = n - last_sleeps;
+    out->sleep_ms = (uint32_t)((us - last_slept_us) / 1000);
+    out->idle_pct[0] = out->idle_pct[1] = 0;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    // The run time counters are in esp_timer microseconds and 32 bits
+    // wide, so they wrap every 71 minutes; the difference is good for any
+    // window shorter than that.
+    for (int core = 0; core < portNUM_PROCESSORS && core < 2; core++) {
+        uint32_t idle = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+        uint64_t pct = window_us ? (uint64_t)(idle - last_idle[core]) * 100 / window_us : 0;
+        out->idle_pct[core] = (uint8_t)(pct > 100 ? 100 : pct);
+        last_idle[core] = idle;
+    }
+#endif
+    last_us = now;
+    last_sleeps = n;
+    last_slept_us = us;
+}
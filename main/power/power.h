@@ -0,0 +1,33 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Power management. With CONFIG_PM_ENABLE and tickless idle (both in
+// sdkconfig.defaults) the CPU scales between POWER_CPU_MIN_MHZ and the
+// default clock, and the chip goes into automatic light sleep whenever
+// every task is blocked for CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP ticks
+// or more. esp_timer alarms and FreeRTOS timeouts wake it in time, the
+// Wi-Fi modem sleeps between beacons (wifi_sta.h) and the MAX7219s keep
+// scanning on their own, so frames and clock ticks land as before.
+//
+// Code that needs sub-millisecond timing (the grayscale scheduler) holds
+// an ESP_PM_NO_LIGHT_SLEEP lock while it runs.
+//
+// power_sample() is what the telemetry reports as "power".
+
+#define POWER_CPU_MIN_MHZ  80  // APB stays at 80 MHz, so SPI and UART clocks hold
+
+typedef struct {
+    uint32_t window_ms;      // since the previous power_sample()
+    uint32_t sleeps;         // light sleeps, i.e. wakeups from light sleep
+    uint32_t sleep_ms;       // time spent in light sleep
+    uint8_t idle_pct[2];     // share of each core's idle task, sleep included
+} power_sample_t;
+
+// Call early in boot, before Wi-Fi is started.
+esp_err_t power_init(void);
+void power_sample(power_sample_t *sample);
+
+#endif
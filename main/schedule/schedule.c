@@ -0,0 +1,133 @@
+#include "schedule.h"
+#include "../MAX7219/MAX7219.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "cJSON.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TAG "SCHEDULE"
+#define NVS_NAMESPACE "display"
+#define NVS_KEY "schedule"
+
+// Written by the MQTT task, read by the clock task: both copy it whole
+// under the lock, so a tick never sees half of an update
+static display_schedule_t schedule;
+static bool schedule_dirty = true;
+static portMUX_TYPE schedule_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool in_window(const schedule_window_t *w, int minute){
+    if (w->from == w->to) return false;
+    if (w->from < w->to) return minute >= w->from && minute < w->to;
+    return minute >= w->from || minute < w->to;  // wraps midnight
+}
+
+static bool parse_hhmm(const cJSON *item, int16_t *out){
+    int hh, mm;
+    if (!cJSON_IsString(item) || sscanf(item->valuestring, "%d:%d", &hh, &mm) != 2 ||
+        hh < 0 || hh > 23 || mm < 0 || mm > 59) {
+        return false;
+    }
+    *out = (int16_t)(hh * 60 + mm);
+    return true;
+}
+
+static bool parse_window(const cJSON *obj, schedule_window_t *w){
+    w->from = w->to = 0;
+    if (obj == NULL) return true;  // not given -> disabled
+    return cJSON_IsObject(obj) &&
+           parse_hhmm(cJSON_GetObjectItem(obj, "from"), &w->from) &&
+           parse_hhmm(cJSON_GetObjectItem(obj, "to"), &w->to);
+}
+
+esp_err_t schedule_init(void){
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return ESP_OK;  // nothing stored yet
+    }
+    display_schedule_t stored;
+    size_t len = sizeof(stored);
+    esp_err_t ret = nvs_get_blob(nvs, NVS_KEY, &stored, &len);
+    nvs_close(nvs);
+    if (ret == ESP_OK && len == sizeof(stored)) {
+        schedule = stored;
+        schedule_dirty = true;
+        ESP_LOGI(TAG, "dim %d-%d @%d, off %d-%d", schedule.dim.from, schedule.dim.to,
+                 schedule.dim_intensity, schedule.off.from, schedule.off.to);
+    }
+    return ESP_OK;
+}
+
+esp_err_t schedule_set_json(const char *json, int len){
+    display_schedule_t next = {0};
+
+    if (len > 0) {
+        cJSON *root = cJSON_ParseWithLength(json, len);
+        if (!root || !cJSON_IsObject(root)) {
+            ESP_LOGE(TAG, "schedule is not a JSON object");
+            cJSON_Delete(root);
+            return ESP_ERR_INVALID_ARG;
+        }
+        const cJSON *dim = cJSON_GetObjectItem(root, "dim");
+        const cJSON *level = dim ? cJSON_GetObjectItem(dim, "intensity") : NULL;
+        bool ok = parse_window(dim, &next.dim) &&
+                  parse_window(cJSON_GetObjectItem(root, "off"), &next.off) &&
+                  (!dim || (cJSON_IsNumber(level) && level->valueint >= 0 && level->valueint <= 15));
+        if (ok && dim) {
+            next.dim_intensity = (uint8_t)level->valueint;
+        }
+        cJSON_Delete(root);
+        if (!ok) {
+            ESP_LOGE(TAG, "bad schedule window");
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    // Retained schedules come again on every resubscribe; only write flash
+    // when something changed
+    if (next.dim.from == schedule.dim.from && next.dim.to == schedule.dim.to &&
+        next.dim_intensity == schedule.dim_intensity &&
+        next.off.from == schedule.off.from && next.off.to == schedule.off.to) {
+        return ESP_OK;
+    }
+    portENTER_CRITICAL(&schedule_lock);
+    schedule = next;
+    schedule_dirty = true;
+    portEXIT_CRITICAL(&schedule_lock);
+
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(nvs, NVS_KEY, &next, sizeof(next));
+        if (ret == ESP_OK) ret = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "schedule not persisted: %s", esp_err_to_name(ret));
+    }
+    return ESP_OK;
+}
+
+void schedule_apply(const struct tm *now){
+    static bool was_off, was_dim;
+    portENTER_CRITICAL(&schedule_lock);
+    display_schedule_t sched = schedule;
+    bool dirty = schedule_dirty;
+    schedule_dirty = false;
+    portEXIT_CRITICAL(&schedule_lock);
+
+    int minute = now->tm_hour * 60 + now->tm_min;
+    bool off = in_window(&sched.off, minute);
+    bool dim = in_window(&sched.dim, minute);
+
+    // only touch the chain on a change; both calls are one transaction each
+    if (dirty || off != was_off) {
+        max7219_set_display_off(off);
+    }
+    if (dirty || dim != was_dim) {
+        max7219_set_intensity_cap(dim ? sched.dim_intensity : 0x0F);
+    }
+    was_off = off;
+    was_dim = dim;
+}
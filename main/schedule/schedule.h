@@ -0,0 +1,36 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+
+// Night windows for the display, configured over MQTT and kept in NVS.
+// The server's /api/schedule publishes them retained on
+//
+//   /classplate/cmd/<device_id>/schedule   (or /classplate/cmd/all/schedule)
+//   {"dim": {"from": "22:00", "to": "06:30", "intensity": 1},
+//    "off": {"from": "01:00", "to": "05:00"}}
+//
+// A window may wrap midnight; a missing window (or an empty payload)
+// disables it. Inside "off" the whole chain is in shutdown, inside "dim"
+// the brightness is capped at the given intensity.
+
+typedef struct {
+    int16_t from;  // minutes since midnight, from == to -> disabled
+    int16_t to;
+} schedule_window_t;
+
+typedef struct {
+    schedule_window_t dim;
+    uint8_t dim_intensity;
+    schedule_window_t off;
+} display_schedule_t;
+
+esp_err_t schedule_init(void);
+esp_err_t schedule_set_json(const char *json, int len);
+// Evaluate the windows for the given local time, call once per clock tick.
+void schedule_apply(const struct tm *now);
+
+#endif
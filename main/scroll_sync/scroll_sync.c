@@ -0,0 +1,164 @@
+#include "scroll_sync.h"
+#include "../MQTT/MQTT.h"
+#include "../display/display.h"
+#include "../dlog/dlog.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define TAG "SYNC"
+
+typedef struct {
+    bool on;
+    int64_t epoch_us;   // wall clock
+    int64_t period_us;
+    int32_t offset;     // columns left of the wall's right end
+} sync_params_t;
+
+// Written on the MQTT task, read by the display task and the timer
+static sync_params_t params;
+static portMUX_TYPE params_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t boundary_timer;
+static widget_t *widget;
+
+static int64_t wall_us(void){
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static sync_params_t get_params(void){
+    portENTER_CRITICAL(&params_lock);
+    sync_params_t p = params;
+    portEXIT_CRITICAL(&params_lock);
+    return p;
+}
+
+static void set_params(const sync_params_t *p){
+    portENTER_CRITICAL(&params_lock);
+    params = *p;
+    portEXIT_CRITICAL(&params_lock);
+}
+
+// Column boundaries passed since the epoch, rounded towards -infinity
+static int64_t steps_at(const sync_params_t *p, int64_t now){
+    int64_t t = now + SCROLL_SYNC_EARLY_US - p->epoch_us;
+    int64_t n = t / p->period_us;
+    return (t < 0 && n * p->period_us != t) ? n - 1 : n;
+}
+
+static void arm(const sync_params_t *p){
+    int64_t now = wall_us();
+    int64_t at = p->epoch_us + (steps_at(p, now) + 1) * p->period_us;
+    esp_timer_stop(boundary_timer);
+    esp_timer_start_once(boundary_timer, at > now ? at - now : 0);
+}
+
+static void on_boundary(void *arg){
+    sync_params_t p = get_params();
+    if (!p.on) {
+        return;
+    }
+    widget_invalidate(widget);
+    display_kick();
+    arm(&p);  // from the wall clock again, so SNTP steps never accumulate
+}
+
+bool scroll_sync_column(int64_t *col){
+    sync_params_t p = get_params();
+    if (!p.on) {
+        return false;
+    }
+    *col = steps_at(&p, wall_us()) - p.offset;
+    return true;
+}
+
+// Copies a complete, short payload into buf as a string
+static bool payload_str(const mqtt_cmd_t *cmd, const char *data, int len, char *buf, size_t size){
+    if (len != cmd->total_len || len >= (int)size) {
+        DLOGW(TAG, "%.*s payload of %d bytes ignored", cmd->kind_len, cmd->kind, cmd->total_len);
+        return false;
+    }
+    memcpy(buf, data, len);
+    buf[len] = '\0';
+    return true;
+}
+
+// MQTT task
+static void on_sync(const mqtt_cmd_t *cmd, const char *data, int len, void *arg){
+    char buf[32];
+    if (!payload_str(cmd, data, len, buf, sizeof(buf))) {
+        return;
+    }
+    sync_params_t p = get_params();
+
+    if (len == 0 || strcmp(buf, "off") == 0) {  // empty: retained sync cleared
+        p.on = false;
+        set_params(&p);
+        esp_timer_stop(boundary_timer);
+        DLOGI(TAG, "scrolling on our own");
+        return;
+    }
+
+    char *end;
+    long long epoch_ms = strtoll(buf, &end, 10);
+    long period_ms = 0;
+    if (end != buf && *end == ',') {
+        char *start = end + 1;
+        period_ms = strtol(start, &end, 10);
+        if (end == start || *end != '\0') {
+            period_ms = 0;
+        }
+    }
+    if (period_ms < SCROLL_SYNC_PERIOD_MIN_MS || period_ms > SCROLL_SYNC_PERIOD_MAX_MS) {
+        DLOGW(TAG, "bad sync \"%s\"", buf);
+        return;
+    }
+
+    p.on = true;
+    p.epoch_us = epoch_ms * 1000;
+    p.period_us = (int64_t)period_ms * 1000;
+    set_params(&p);
+    arm(&p);
+    DLOGI(TAG, "scrolling with the wall, %ld ms per column, offset %ld",
+          period_ms, (long)p.offset);
+}
+
+// MQTT task
+static void on_wall(const mqtt_cmd_t *cmd, const char *data, int len, void *arg){
+    char buf[12];
+    if (!payload_str(cmd, data, len, buf, sizeof(buf))) {
+        return;
+    }
+    char *end;
+    long offset = strtol(buf, &end, 10);
+    if (end == buf || *end != '\0' || offset < 0) {
+        offset = 0;  // cleared or nonsense: the right end of the wall
+    }
+    sync_params_t p = get_params();
+    p.offset = (int32_t)offset;
+    set_params(&p);
+    widget_invalidate(widget);
+    DLOGI(TAG, "%ld columns from the right end of the wall", offset);
+}
+
+esp_err_t scroll_sync_start(widget_t *w){
+    widget = w;
+    const esp_timer_create_args_t args = {
+        .callback = on_boundary,
+        .name = "scroll_sync",
+    };
+    esp_err_t ret = esp_timer_create(&args, &boundary_timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = mqtt_register_command("sync", on_sync, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return mqtt_register_command("wall", on_wall, NULL);
+}
@@ -0,0 +1,44 @@
+#ifndef SCROLL_SYNC_H
+#define SCROLL_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "../widget/widget.h"
+
+// One message flowing across several signs mounted side by side.
+//
+// No frames go over the network. Each sign derives the marquee column
+// from its SNTP-disciplined wall clock:
+//
+//   column = floor((now - epoch) / period) - offset
+//
+// epoch and period are broadcast once to the whole wall; offset is how
+// many columns this sign sits left of the wall's right end (32 per sign
+// to its right), so a sign shows what its right neighbour showed offset
+// periods earlier. Before the epoch the column is negative and the zone
+// blank, which lets every sign start a new message at the same instant.
+// A one-shot esp_timer fires on each column boundary, as the clock does
+// on the second, so neighbours step within their SNTP error of each
+// other instead of up to a frame apart.
+//
+//   /classplate/cmd/all/sync     "<epoch_ms>,<period_ms>", "off" to stop
+//   /classplate/cmd/<id>/wall    "<offset_cols>"
+//
+// Both are meant to be retained. Without a sync the marquee runs free
+// at its own cadence, as before.
+
+#define SCROLL_SYNC_PERIOD_MIN_MS   20
+#define SCROLL_SYNC_PERIOD_MAX_MS 1000
+// A boundary timer may fire this early and still count as on time
+#define SCROLL_SYNC_EARLY_US      2000
+
+// Register the commands (before mqtt_init()); w is invalidated and the
+// display kicked on every column boundary while synced.
+esp_err_t scroll_sync_start(widget_t *w);
+
+// The stream column (see marquee_seek()) to show now. False while not
+// synced; *col is left alone then.
+bool scroll_sync_column(int64_t *col);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef TASK_STACKS_H
+#define TASK_STACKS_H
+
+// Stack sizes of our own tasks, in bytes. Size them from the "stack_free"
+// high-water marks in the telemetry (see telemetry.h) and keep at least
+// TELEMETRY_STACK_LOW_BYTES of headroom, more for tasks with rarely taken
+// paths (TLS errors, JSON parse failures).
+
+// Boot (NVS, SPI, Wi-Fi and SNTP init), then the app loop: telemetry and
+// trace formatting, MQTT enqueues. The telemetry payload is static.
+#define TASK_STACK_ENGINE    5120
+// HTTP weather fallback: esp_http_client, lwIP socket calls and the cJSON
+// parse. The response buffer is on the heap, only while fetching.
+#define TASK_STACK_WEATHER   6144
+// vsync callbacks (marquee step, clock) plus the commit. Deepest are a
+// DLOG's vsnprintf into the ring and, in grayscale, the 256-byte zone of
+// levels with a peeked marquee copy; about 2 KB, so half is headroom.
+#define TASK_STACK_DISPLAY   4096
+// Deferred log drain: printf of one formatted line at a time.
+#define TASK_STACK_DLOG      3072
+// Grayscale plane scheduler: timer calls and the plane load, nothing deep.
+#define TASK_STACK_GRAY      2048
+
+#endif
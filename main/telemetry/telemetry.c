@@ -0,0 +1,148 @@
+#include "telemetry.h"
+#include "../MQTT/MQTT.h"
+#include "../dlog/dlog.h"
+#include "../clock/clock.h"
+#include "../widget/widget.h"
+#include "../app_loop/app_loop.h"
+#include "../gray/gray.h"
+#include "../power/power.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#define TAG "TELEMETRY"
+
+// Looked up by name each sample, so tasks started later (or by IDF
+// components) show up without registering anywhere.
+static const char *const tracked_tasks[] = {
+    "engine_task",  // the app loop
+    "display_task",
+    "dlog",
+    "gray_task",  // once grayscale was switched on
+    "weather",    // HTTP fallback fetch
+    "mqtt_task",
+    "esp_timer",
+    "tiT",       // lwIP
+    "sys_evt",   // default event loop
+    "wifi",
+};
+
+static const struct {
+    const char *name;
+    uint32_t caps;
+} heap_kinds[] = {
+    {"internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT},
+    {"dma",      MALLOC_CAP_DMA},
+    {"spiram",   MALLOC_CAP_SPIRAM},
+};
+
+static esp_timer_handle_t telemetry_timer;
+// Static so the app loop's stack (TASK_STACK_ENGINE) need not hold it.
+static char payload[1024];
+
+static int append(int len, const char *fmt, ...){
+    if (len < 0 || len >= (int)sizeof(payload)) {
+        return -1;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(payload + len, sizeof(payload) - len, fmt, ap);
+    va_end(ap);
+    return n < 0 ? -1 : len + n;
+}
+
+static void telemetry_timer_cb(void *arg){
+    static bool periodic = false;
+    if (!periodic) {
+        // the first sample was a one-shot, from now on every period
+        periodic = true;
+        esp_timer_start_periodic(telemetry_timer, (uint64_t)TELEMETRY_PERIOD_MS * 1000);
+    }
+    app_loop_post(APP_EVT_TELEMETRY_DUE, 0);
+}
+
+static void telemetry_sample(const app_event_t *event, void *arg){
+
+    int len = append(0, "{\"heap\":{");
+    bool first = true;
+    for (size_t i = 0; i < sizeof(heap_kinds) / sizeof(heap_kinds[0]); i++) {
+        uint32_t caps = heap_kinds[i].caps;
+        if (heap_caps_get_total_size(caps) == 0) {
+            continue;  // no PSRAM fitted
+        }
+        len = append(len, "%s\"%s\":{\"free\":%u,\"min\":%u,\"largest\":%u}",
+                     first ? "" : ",", heap_kinds[i].name,
+                     (unsigned)heap_caps_get_free_size(caps),
+                     (unsigned)heap_caps_get_minimum_free_size(caps),
+                     (unsigned)heap_caps_get_largest_free_block(caps));
+        first = false;
+    }
+
+    len = append(len, "},\"stack_free\":{");
+    first = true;
+    for (size_t i = 0; i < sizeof(tracked_tasks) / sizeof(tracked_tasks[0]); i++) {
+        TaskHandle_t task = xTaskGetHandle(tracked_tasks[i]);
+        if (task == NULL) {
+            continue;
+        }
+        // bytes on ESP-IDF, not words
+        unsigned stack_free = (unsigned)uxTaskGetStackHighWaterMark(task);
+        if (stack_free < TELEMETRY_STACK_LOW_BYTES) {
+            ESP_LOGW(TAG, "%s: only %u bytes of stack left", tracked_tasks[i], stack_free);
+        }
+        len = append(len, "%s\"%s\":%u", first ? "" : ",", tracked_tasks[i], stack_free);
+        first = false;
+    }
+    clock_stats_t clk;
+    clock_get_stats(&clk);
+    len = append(len, "},\"clock\":{\"ticks\":%u,\"err_us\":%d,\"avg_us\":%d,\"max_us\":%d,\"late\":%u}",
+                 (unsigned)clk.ticks, (int)clk.last_us, (int)clk.avg_us, (int)clk.max_us, (unsigned)clk.late);
+    widget_stats_t wid;
+    widget_get_stats(&wid);
+    len = append(len, ",\"widgets\":{\"renders\":%u,\"draws\":%u}",
+                 (unsigned)wid.renders, (unsigned)wid.draws);
+    app_loop_stats_t loop;
+    app_loop_get_stats(&loop);
+    len = append(len, ",\"loop\":{\"events\":%u,\"dropped\":%u,\"lat_avg_us\":%u,"
+                      "\"lat_max_us\":%u,\"busy_max_us\":%u,\"busy_max_id\":%d}",
+                 (unsigned)loop.events, (unsigned)loop.dropped, (unsigned)loop.latency_avg_us,
+                 (unsigned)loop.latency_max_us, (unsigned)loop.busy_max_us, (int)loop.busy_max_id);
+    gray_stats_t gray;
+    gray_get_stats(&gray);
+    len = append(len, ",\"gray\":{\"bits\":%u,\"cycles\":%u,\"load_avg_us\":%u,\"load_max_us\":%u,"
+                      "\"late_max_us\":%u,\"overruns\":%u}",
+                 (unsigned)gray.bits, (unsigned)gray.cycles, (unsigned)gray.load_avg_us,
+                 (unsigned)gray.load_max_us, (unsigned)gray.late_max_us, (unsigned)gray.overruns);
+    power_sample_t pwr;
+    power_sample(&pwr);
+    len = append(len, ",\"power\":{\"window_ms\":%u,\"sleeps\":%u,\"sleep_ms\":%u,\"idle_pct\":[%u,%u]}",
+                 (unsigned)pwr.window_ms, (unsigned)pwr.sleeps, (unsigned)pwr.sleep_ms,
+                 (unsigned)pwr.idle_pct[0], (unsigned)pwr.idle_pct[1]);
+    len = append(len, ",\"log_dropped\":%u}", (unsigned)dlog_dropped());
+
+    if (len < 0 || len >= (int)sizeof(payload)) {
+        ESP_LOGE(TAG, "Telemetry does not fit in %u bytes", (unsigned)sizeof(payload));
+        return;
+    }
+    ESP_LOGI(TAG, "%s", payload);
+    mqtt_publish_telemetry(payload, len);
+}
+
+esp_err_t telemetry_start(void){
+    const esp_timer_create_args_t args = {
+        .callback = telemetry_timer_cb,
+        .name = "telemetry",
+    };
+    esp_err_t ret = esp_timer_create(&args, &telemetry_timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    app_loop_register(APP_EVT_TELEMETRY_DUE, telemetry_sample, NULL);
+    return esp_timer_start_once(telemetry_timer, (uint64_t)TELEMETRY_FIRST_MS * 1000);
+}
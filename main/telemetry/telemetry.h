@@ -0,0 +1,42 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "esp_err.h"
+
+// Stack and heap headroom, sampled from an esp_timer and published on
+//
+//   /classplate/telemetry/<device id>
+//   {"heap": {"internal": {"free": 81234, "min": 60112, "largest": 45056},
+//             "dma": {...}, "spiram": {...}},
+//    "stack_free": {"display_task": 1480, "mqtt_task": 2210, ...},
+//    "clock": {"ticks": 300, "err_us": 410, "avg_us": 380, "max_us": 2900, "late": 0},
+//    "widgets": {"renders": 3900, "draws": 3650},
+//    "loop": {"events": 14, "dropped": 0, "lat_avg_us": 90, "lat_max_us": 2100,
+//             "busy_max_us": 850000, "busy_max_id": 2},
+//    "gray": {"bits": 3, "cycles": 29800, "load_avg_us": 140, "load_max_us": 410,
+//             "late_max_us": 380, "overruns": 0},
+//    "power": {"window_ms": 300000, "sleeps": 3700, "sleep_ms": 262000,
+//              "idle_pct": [96, 99]},
+//    "log_dropped": 0}
+//
+// "min" is the lowest free heap since boot and "stack_free" the smallest
+// amount of stack a task has ever had left (its high-water mark), both in
+// bytes. These are the numbers to size the stacks in task_stacks.h from.
+// "clock" is how far from the second boundary the clock digits were
+// committed (see clock.h). "widgets" counts zone renders and how many of
+// them actually changed the zone; the rest were cache hits. "loop" is the
+// app loop: how long events waited for it and the longest one it ran
+// (busy_max_id is an app_event_id_t, see app_loop.h). "gray" is the
+// grayscale plane scheduler (gray.h), all zero unless it was switched on.
+// "power" covers the time since the previous sample: light sleeps (each
+// one a wakeup), the time spent in them and how much of each core went to
+// its idle task, sleep included (power.h).
+
+#define TELEMETRY_PERIOD_MS        300000  // every 5 minutes
+#define TELEMETRY_FIRST_MS          30000  // first sample once boot settled
+// Tasks with less stack left than this are logged as a warning.
+#define TELEMETRY_STACK_LOW_BYTES     512
+
+esp_err_t telemetry_start(void);
+
+#endif
@@ -0,0 +1,163 @@
+#include "trace.h"
+
+#if TRACE_ENABLED
+
+#include "../MQTT/MQTT.h"
+#include "../app_loop/app_loop.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TAG "TRACE"
+
+typedef struct {
+    uint32_t ts;        // esp_timer µs, low 32 bits (the converter unwraps)
+    uint8_t id;
+    char phase;         // 'B', 'E' or 'i', as in the Chrome format
+    uint16_t reserved;
+    uint32_t arg;
+    void *task;
+} trace_event_t;
+
+enum { TRACE_TO_MQTT, TRACE_TO_CONSOLE };
+
+static const char *const names[TRACE_ID_MAX] = {
+    [TRACE_FRAME]      = "frame",
+    [TRACE_COMMIT]     = "commit",
+    [TRACE_SCRUB]      = "scrub",
+    [TRACE_SPI]        = "spi",
+    [TRACE_SPI_WAIT]   = "spi_wait",
+    [TRACE_MQTT_EVENT] = "mqtt_event",
+    [TRACE_MUTEX_WAIT] = "mutex_wait",
+    [TRACE_MUTEX_BUSY] = "mutex_busy",
+    [TRACE_HTTP_FETCH] = "http_fetch",
+    [TRACE_APP_EVENT]  = "app_event",
+    [TRACE_CLOCK_TICK] = "clock_tick",
+    [TRACE_GRAY_PLANE] = "gray_plane",
+};
+
+// Task names are resolved at dump time from the handles; these are the
+// tasks that record anything.
+static const char *const task_names[] = {
+    "engine_task", "display_task", "mqtt_task", "esp_timer", "sys_evt", "dlog",
+    "gray_task", "weather",
+};
+
+static trace_event_t ring[TRACE_EVENTS];
+static uint32_t head;
+static bool recording;
+static uint32_t cost_ns;
+
+void trace_record(trace_id_t id, char phase, uint32_t arg){
+    if (!__atomic_load_n(&recording, __ATOMIC_RELAXED)) {
+        return;
+    }
+    uint32_t pos = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    trace_event_t *e = &ring[pos & (TRACE_EVENTS - 1)];
+    e->ts = (uint32_t)esp_timer_get_time();
+    e->id = id;
+    e->phase = phase;
+    e->arg = arg;
+    e->task = xTaskGetCurrentTaskHandle();
+}
+
+// Output: whole lines, either printed with a "TRACE " prefix (so the
+// converter can pick them out of a console log) or packed into MQTT
+// messages of up to TRACE_CHUNK_BYTES.
+static char chunk[TRACE_CHUNK_BYTES];
+static int chunk_len;
+
+static void emit(int to, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void emit(int to, const char *fmt, ...){
+    char line[96];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (len < 0 || len >= (int)sizeof(line)) {
+        return;
+    }
+    if (to == TRACE_TO_CONSOLE) {
+        printf("TRACE %s", line);
+        return;
+    }
+    if (chunk_len + len > (int)sizeof(chunk)) {
+        mqtt_publish_trace(chunk, chunk_len);
+        chunk_len = 0;
+    }
+    memcpy(chunk + chunk_len, line, len);
+    chunk_len += len;
+}
+
+static void trace_dump(int to){
+    // Freeze the ring; a record already past the check lands within µs
+    __atomic_store_n(&recording, false, __ATOMIC_RELAXED);
+    vTaskDelay(1);
+
+    uint32_t end = head;
+    uint32_t count = end < TRACE_EVENTS ? end : TRACE_EVENTS;
+    chunk_len = 0;
+    emit(to, "# classplate-trace 1 events=%lu lost=%lu cost_ns=%lu\n",
+         (unsigned long)count, (unsigned long)(end - count), (unsigned long)cost_ns);
+    for (size_t i = 0; i < sizeof(task_names) / sizeof(task_names[0]); i++) {
+        TaskHandle_t task = xTaskGetHandle(task_names[i]);
+        if (task != NULL) {
+            emit(to, "T %08lx %s\n", (unsigned long)(uintptr_t)task, task_names[i]);
+        }
+    }
+    for (uint32_t pos = end - count; pos != end; pos++) {
+        const trace_event_t *e = &ring[pos & (TRACE_EVENTS - 1)];
+        emit(to, "%lu %c %s %08lx %lu\n", (unsigned long)e->ts, e->phase,
+             e->id < TRACE_ID_MAX ? names[e->id] : "?",
+             (unsigned long)(uintptr_t)e->task, (unsigned long)e->arg);
+    }
+    emit(to, "# end\n");
+    if (to == TRACE_TO_MQTT && chunk_len > 0) {
+        mqtt_publish_trace(chunk, chunk_len);
+    }
+
+    // Start over, so the next dump doesn't repeat this one
+    head = 0;
+    __atomic_store_n(&recording, true, __ATOMIC_RELAXED);
+}
+
+static void trace_on_dump(const app_event_t *event, void *arg){
+    trace_dump(event->arg);
+}
+
+static void trace_on_command(const mqtt_cmd_t *cmd, const char *data, int len, void *arg){
+    if (len == 5 && memcmp(data, "start", 5) == 0) {
+        __atomic_store_n(&recording, true, __ATOMIC_RELAXED);
+    } else if (len == 4 && memcmp(data, "stop", 4) == 0) {
+        __atomic_store_n(&recording, false, __ATOMIC_RELAXED);
+    } else if (len == 4 && memcmp(data, "dump", 4) == 0) {
+        app_loop_post(APP_EVT_TRACE_DUMP, TRACE_TO_MQTT);
+    } else if (len == 5 && memcmp(data, "print", 5) == 0) {
+        app_loop_post(APP_EVT_TRACE_DUMP, TRACE_TO_CONSOLE);
+    }
+}
+
+esp_err_t trace_start(void){
+    // What a record costs on this chip, for reading the dump
+    const int rounds = 64;
+    recording = true;
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < rounds; i++) {
+        trace_record(TRACE_FRAME, 'i', 0);
+    }
+    cost_ns = (uint32_t)((esp_timer_get_time() - t0) * 1000 / rounds);
+    head = 0;
+
+    ESP_LOGI(TAG, "recording, %d events, %lu ns per event",
+             TRACE_EVENTS, (unsigned long)cost_ns);
+    app_loop_register(APP_EVT_TRACE_DUMP, trace_on_dump, NULL);
+    return mqtt_register_command("trace", trace_on_command, NULL);
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Event trace for chasing stutter: frames, SPI transactions, MQTT and
+// HTTP activity, lock waits and app loop events go into a RAM ring with a
+// microsecond timestamp and the task they ran on. Dump it over MQTT
+//
+//   /classplate/cmd/<device>/trace   "start" | "stop" | "dump" | "print"
+//
+// ("dump" publishes on /classplate/trace/<device>, "print" writes to the
+// console) and turn it into a chrome://tracing / Perfetto file with
+// tools/trace2chrome.py.
+//
+// Off unless built with `idf.py -DTRACE=1 build`: then TRACE_ENABLED is 1.
+// Otherwise the TRACE_* macros expand to nothing. When on, a record is a
+// timer read, one atomic add and a 16 byte store. The dump header gives
+// the cost measured at boot.
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+#define TRACE_EVENTS       1024   // power of two, 16 bytes each
+#define TRACE_CHUNK_BYTES  1536   // MQTT payload per dump message
+
+typedef enum {
+    TRACE_FRAME,        // display task: vsync callbacks + commit
+    TRACE_COMMIT,
+    TRACE_SCRUB,
+    TRACE_SPI,          // one chain transaction, arg = first register
+    TRACE_SPI_WAIT,     // waited for the bus lock
+    TRACE_MQTT_EVENT,   // arg = esp_mqtt_event_id_t
+    TRACE_MUTEX_WAIT,   // waited for mqtt_mutex
+    TRACE_MUTEX_BUSY,   // display skipped a step, mqtt_mutex held
+    TRACE_HTTP_FETCH,
+    TRACE_APP_EVENT,    // arg = app_event_id_t
+    TRACE_CLOCK_TICK,
+    TRACE_GRAY_PLANE,   // arg = bit-plane
+    TRACE_ID_MAX,
+} trace_id_t;
+
+#if TRACE_ENABLED
+
+void trace_record(trace_id_t id, char phase, uint32_t arg);
+
+#define TRACE_BEGIN(id, arg)    trace_record(id, 'B', arg)
+#define TRACE_END(id, arg)      trace_record(id, 'E', arg)
+#define TRACE_INSTANT(id, arg)  trace_record(id, 'i', arg)
+
+// Calibrate and register the "trace" command; call before mqtt_init().
+esp_err_t trace_start(void);
+
+#else
+
+#define TRACE_BEGIN(id, arg)    do { } while (0)
+#define TRACE_END(id, arg)      do { } while (0)
+#define TRACE_INSTANT(id, arg)  do { } while (0)
+
+static inline esp_err_t trace_start(void) { return ESP_OK; }
+
+#endif
+
+#endif
@@ -0,0 +1,114 @@
+#include "widget.h"
+#include "../MAX7219/MAX7219.h"
+#include "../display/display.h"
+
+#include "esp_log.h"
+
+#include <string.h>
+
+#define TAG "WIDGET"
+
+static widget_t *widgets[WIDGET_MAX];
+static int widget_count;
+static bool pending;       // some widget was added or invalidated
+static uint32_t next_due;  // earliest frame a periodic widget is due
+static widget_stats_t stats;
+
+static uint32_t period_frames(const widget_t *w){
+    uint32_t frames = w->period_ms / DISPLAY_FRAME_MS;
+    return frames > 0 ? frames : 1;
+}
+
+static void widget_run(widget_t *w){
+    if (w->update != NULL && !w->update(w)) {
+        return;
+    }
+
+    if (w->render_levels != NULL && max7219_gray_bits() > 0) {
+        uint8_t levels[WIDGET_ZONE_MAX * 64];
+        w->render_levels(w, levels);
+        draw_zone_levels(w->first_module, w->num_modules, levels);
+        w->cached = false;  // the rows cache no longer matches the zone
+        stats.renders++;
+        stats.draws++;
+        return;
+    }
+
+    uint8_t rows[WIDGET_ZONE_MAX * 8] = {0};
+    size_t len = w->num_modules * 8;
+    w->render(w, rows);
+    stats.renders++;
+    if (w->cached && memcmp(rows, w->cache, len) == 0) {
+        return;  // the zone already shows this
+    }
+    memcpy(w->cache, rows, len);
+    w->cached = true;
+    draw_zone(w->first_module, w->num_modules, rows);
+    stats.draws++;
+}
+
+// Until the next periodic widget is due, unless one was invalidated
+// meanwhile without a kick
+static void widget_idle_vote(uint32_t frame){
+    bool again = __atomic_load_n(&pending, __ATOMIC_ACQUIRE);
+    display_idle_until(again ? frame + 1 : next_due);
+}
+
+static void widget_vsync(uint32_t frame, void *arg){
+    bool any_invalid = __atomic_exchange_n(&pending, false, __ATOMIC_ACQUIRE);
+    if (!any_invalid && (int32_t)(frame - next_due) < 0) {
+        widget_idle_vote(frame);
+        return;
+    }
+
+    // Nothing periodic: look again in about a month of frames
+    uint32_t earliest = frame + 0x7fffffff;
+    int count = __atomic_load_n(&widget_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++) {
+        widget_t *w = widgets[i];
+        bool invalid = __atomic_exchange_n(&w->invalid, false, __ATOMIC_ACQUIRE);
+        bool due = w->period_ms > 0 && (!w->scheduled || (int32_t)(frame - w->due) >= 0);
+        if (due) {
+            w->due = frame + period_frames(w);
+            w->scheduled = true;
+        }
+        if (invalid || due) {
+            widget_run(w);
+        }
+        if (w->period_ms > 0 && (int32_t)(w->due - earliest) < 0) {
+            earliest = w->due;
+        }
+    }
+    next_due = earliest;
+    widget_idle_vote(frame);
+}
+
+esp_err_t widget_start(void){
+    return display_vsync_register(widget_vsync, NULL);
+}
+
+esp_err_t widget_add(widget_t *w){
+    if (w == NULL || w->render == NULL || w->num_modules < 1 || w->num_modules > WIDGET_ZONE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (widget_count >= WIDGET_MAX) {
+        ESP_LOGE(TAG, "No free widget slot for %s", w->name);
+        return ESP_ERR_NO_MEM;
+    }
+    w->scheduled = false;
+    w->cached = false;
+    w->invalid = true;
+    widgets[widget_count] = w;
+    __atomic_store_n(&widget_count, widget_count + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&pending, true, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+void widget_invalidate(widget_t *w){
+    __atomic_store_n(&w->invalid, true, __ATOMIC_RELEASE);
+    __atomic_store_n(&pending, true, __ATOMIC_RELEASE);
+}
+
+void widget_get_stats(widget_stats_t *out){
+    *out = stats;
+}
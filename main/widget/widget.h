@@ -0,0 +1,69 @@
+#ifndef WIDGET_H
+#define WIDGET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Zones of the chain as widgets, all driven from the display task.
+//
+// A widget owns modules first_module .. first_module + num_modules - 1
+// and declares how often it wants to run: every period_ms, or (period 0)
+// only after widget_invalidate(). When it is due the scheduler calls
+// update() to take in new inputs, then render() into a scratch zone, and
+// only draws the zone if the bitmap differs from the last one it drew.
+// A frame where nothing is due or invalidated costs one comparison.
+//
+// update() may return false to say nothing changed (or there is nothing
+// to show yet); render() is then skipped and the zone left as it is. A
+// widget without update() renders every time it is due. Both run on the
+// display task and must not block. A new kind of widget is a pair of
+// callbacks and a widget_t, not another task.
+//
+// While grayscale is on (gray.h), a widget with render_levels() is drawn
+// from that instead, one level per LED (see draw_zone_levels()); others
+// keep rendering on/off rows.
+
+#define WIDGET_MAX       8
+#define WIDGET_ZONE_MAX  4   // modules per widget
+
+typedef struct widget widget_t;
+
+struct widget {
+    const char *name;
+    int first_module;
+    int num_modules;
+    uint32_t period_ms;   // 0 = only when invalidated
+    bool (*update)(widget_t *w);
+    void (*render)(widget_t *w, uint8_t *rows);  // num_modules * 8 rows, zeroed
+    void (*render_levels)(widget_t *w, uint8_t *levels);  // optional, num_modules * 64
+    void *ctx;
+
+    // Scheduler state, leave zeroed
+    bool invalid;
+    bool scheduled;
+    bool cached;
+    uint32_t due;         // frame
+    uint8_t cache[WIDGET_ZONE_MAX * 8];
+};
+
+typedef struct {
+    uint32_t renders;     // render() calls
+    uint32_t draws;       // renders that changed the zone
+} widget_stats_t;
+
+// Register the scheduler with the display; call before display_start().
+esp_err_t widget_start(void);
+
+// Add a widget; it runs on the next frame. Safe while the display runs.
+esp_err_t widget_add(widget_t *w);
+
+// Run w on the next frame. Safe from any task or esp_timer callback.
+// It does not wake the display task, which may be sleeping through idle
+// frame slots (up to DISPLAY_IDLE_MAX_FRAMES); follow with display_kick()
+// for content that cannot wait.
+void widget_invalidate(widget_t *w);
+
+void widget_get_stats(widget_stats_t *stats);
+
+#endif
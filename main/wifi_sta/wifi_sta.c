@@ -7,7 +7,13 @@
 
 #include "freertos/event_groups.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "nvs.h"
 #include "wifi_sta.h"
+#include "../app_loop/app_loop.h"
+
+#include <string.h>
 
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
@@ -19,39 +25,166 @@ static EventGroupHandle_t s_wifi_event_group;
 #define WIFI_FAIL_BIT      BIT1
 #define TAG "WIFI_STA"
 
-static int s_retry_num = -1;
+static int s_retry_num = 0;
+static bool s_online;             // had an IP since the last NET_DOWN
+
+// Fast reconnect: the AP we last got an IP from (BSSID + channel) is kept
+// in NVS, so the next boot joins it directly instead of scanning every
+// channel. The DHCP lease is restored by lwIP itself
+// (CONFIG_LWIP_DHCP_RESTORE_LAST_IP in sdkconfig.defaults).
+#define WIFI_NVS_NAMESPACE "wifi"
+#define WIFI_NVS_KEY       "fast"
+#define WIFI_FAST_VERSION  1
+
+typedef struct {
+    uint8_t version;
+    uint8_t channel;
+    uint8_t bssid[6];
+} wifi_fast_t;
+
+static wifi_fast_t s_fast;        // what NVS holds, version 0 if nothing
+static bool s_fast_active;        // current attempt uses the cached AP
+static wifi_config_t s_wifi_config;
+static esp_timer_handle_t s_retry_timer;
+static int64_t s_start_us;
+
+static void wifi_fast_load(void){
+    nvs_handle_t nvs;
+    size_t len = sizeof(s_fast);
+    memset(&s_fast, 0, sizeof(s_fast));
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(nvs, WIFI_NVS_KEY, &s_fast, &len) != ESP_OK ||
+        len != sizeof(s_fast) || s_fast.version != WIFI_FAST_VERSION) {
+        memset(&s_fast, 0, sizeof(s_fast));
+    }
+    nvs_close(nvs);
+}
+
+static void wifi_fast_store(const uint8_t bssid[6], uint8_t channel){
+    if (s_fast.version == WIFI_FAST_VERSION && s_fast.channel == channel &&
+        memcmp(s_fast.bssid, bssid, 6) == 0) {
+        return;  // unchanged, spare the flash
+    }
+    s_fast.version = WIFI_FAST_VERSION;
+    s_fast.channel = channel;
+    memcpy(s_fast.bssid, bssid, 6);
+
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(nvs, WIFI_NVS_KEY, &s_fast, sizeof(s_fast)) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
+// Point the station at the cached AP, or back to a full scan.
+static void wifi_apply_target(bool fast){
+    s_fast_active = fast && s_fast.version == WIFI_FAST_VERSION;
+    if (s_fast_active) {
+        memcpy(s_wifi_config.sta.bssid, s_fast.bssid, 6);
+        s_wifi_config.sta.bssid_set = true;
+        s_wifi_config.sta.channel = s_fast.channel;
+        s_wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    } else {
+        s_wifi_config.sta.bssid_set = false;
+        s_wifi_config.sta.channel = 0;
+        s_wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        s_wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+}
+
+static void wifi_retry_cb(void *arg){
+    esp_wifi_connect();
+}
+
+// First retry right away (most drops are one-off), then exponential
+// backoff with jitter so a whole site does not hammer the AP in lockstep
+// after a power blip.
+static uint32_t wifi_backoff_ms(int attempt){
+    if (attempt <= 1) {
+        return 0;
+    }
+    uint32_t delay = WIFI_BACKOFF_MIN_MS << (attempt - 2 < 10 ? attempt - 2 : 10);
+    if (delay > WIFI_BACKOFF_MAX_MS) {
+        delay = WIFI_BACKOFF_MAX_MS;
+    }
+    return delay / 2 + (uint32_t)(esp_random() % (delay / 2 + 1));
+}
 
 static void event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
 {
-    printf("s_retry: %d\n", s_retry_num);
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t* event = (wifi_event_sta_connected_t*) event_data;
+        wifi_fast_store(event->bssid, event->channel);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < WIFI_MAXIMUM_RETRY) {
+        wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
+        if (s_online) {
+            s_online = false;
+            app_loop_post(APP_EVT_NET_DOWN, event->reason);
+        }
+        s_retry_num++;
+        if (WIFI_MAXIMUM_RETRY != 0 && s_retry_num > WIFI_MAXIMUM_RETRY) {
+            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+            return;
+        }
+        if (s_fast_active) {
+            // cached AP gone, moved channel or refused us: full scan now
+            ESP_LOGW(TAG, "fast connect failed (reason %d), scanning", event->reason);
+            wifi_apply_target(false);
+            esp_wifi_connect();
+            return;
+        }
+        if (s_retry_num == 1 && s_fast.version == WIFI_FAST_VERSION) {
+            // dropped while online: rejoin the AP we were on directly
+            wifi_apply_target(true);
+            esp_wifi_connect();
+            return;
+        }
+        uint32_t delay_ms = wifi_backoff_ms(s_retry_num);
+        ESP_LOGI(TAG, "retry %d to connect to the AP in %" PRIu32 " ms (reason %d)",
+                 s_retry_num, delay_ms, event->reason);
+        if (delay_ms == 0) {
             esp_wifi_connect();
-            s_retry_num = (WIFI_MAXIMUM_RETRY == 0)?-1:s_retry_num + 1;
-            ESP_LOGI(TAG, "retry to connect to the AP");
         } else {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+            esp_timer_start_once(s_retry_timer, (uint64_t)delay_ms * 1000);
         }
-        // ESP_LOGI(TAG,"connect to the AP fail");
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = -1;
+        ESP_LOGI(TAG, "got ip:" IPSTR " %lld ms after start%s", IP2STR(&event->ip_info.ip),
+                 (long long)((esp_timer_get_time() - s_start_us) / 1000), s_fast_active ? " (fast path)" : "");
+        s_retry_num = 0;
+        s_online = true;
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        app_loop_post(APP_EVT_NET_UP, 0);
     }
 }
 
 
 esp_err_t wifi_init_sta(void){
+    s_start_us = esp_timer_get_time();
     s_wifi_event_group = xEventGroupCreate();
+    wifi_fast_load();
+
+    const esp_timer_create_args_t retry_args = {
+        .callback = wifi_retry_cb,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_args, &s_retry_timer));
 
     esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    // the config is set on every boot, no need to also keep it in flash
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
 
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
@@ -81,9 +214,12 @@ esp_err_t wifi_init_sta(void){
         },
     };
 
+    s_wifi_config = wifi_config;
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
+    wifi_apply_target(true);
+    ESP_LOGI(TAG, "%s", s_fast_active ? "fast connect to cached AP" : "no cached AP, full scan");
     ESP_ERROR_CHECK(esp_wifi_start() );
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_MODE));
 
     ESP_LOGI(TAG, "wifi_init_sta finished.");
 
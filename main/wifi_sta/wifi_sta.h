@@ -7,6 +7,14 @@
 #define WIFI_PASS      "12345678"
 
 #define WIFI_MAXIMUM_RETRY 0 // 0 for infinite retries
+#define WIFI_BACKOFF_MIN_MS 500    // second retry, doubles from there
+#define WIFI_BACKOFF_MAX_MS 30000
+
+// Modem sleep: the radio stays associated and wakes for every DTIM beacon
+// (100-300 ms on most APs), well inside the MQTT keepalive; commands see at
+// most one beacon interval of extra latency. Automatic light sleep
+// (main/power) needs it. WIFI_PS_NONE keeps the radio on for good.
+#define WIFI_PS_MODE WIFI_PS_MIN_MODEM
 
 esp_err_t wifi_init_sta(void);
 
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""Compile a ClassPlate text font into the binary blob read by main/font/font.c.
+
+Source format (fonts/*.txt):
+
+    # comment
+    height 8
+    default U+FFFD          glyph drawn for codepoints the font lacks
+
+    U+0041 A                one header line per glyph, text after the
+    .###.                   codepoint is ignored; then `height` rows, '#'
+    #...#                   for a lit LED, anything else for unlit. The
+    ...                     row length is the glyph width (1..8).
+
+Blob layout, all integers little endian:
+
+    0   char[4]  magic "CPF1"
+    4   u16      version (1)
+    6   u8       height (1..8)
+    7   u8       flags (0)
+    8   u32      glyph count
+    12  u32      glyph data length
+    16  u32      CRC-32 (IEEE) of index + glyph data
+    20  u32      default codepoint
+    24  index    glyph count x {u32 codepoint, u32 offset | width << 24},
+                 sorted by codepoint
+    ..  data     glyph bitstreams
+
+A glyph is `width` columns, left to right, written MSB first as a bit
+stream: '0' repeats the previous column (an empty column before the first
+one), '1' is followed by `height` bits of a new column, top row first.
+Each glyph starts on a byte boundary.
+
+Write the result into the "font" partition without reflashing the app:
+
+    python tools/mkfont.py fonts/default.txt -o font.bin
+    parttool.py write_partition --partition-name font --input font.bin
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b"CPF1"
+VERSION = 1
+HEADER = struct.Struct("<4sHBBIIII")
+MAX_WIDTH = 8
+MAX_HEIGHT = 8
+
+
+class FontError(Exception):
+    pass
+
+
+def parse_codepoint(tok):
+    if tok.upper().startswith("U+"):
+        return int(tok[2:], 16)
+    raise FontError("expected U+XXXX, got %r" % tok)
+
+
+def parse(path):
+    height = None
+    default = 0xFFFD
+    glyphs = {}
+    with open(path, encoding="utf-8") as f:
+        lines = [l.rstrip("\n") for l in f]
+
+    i = 0
+    while i < len(lines):
+        line = lines[i].strip()
+        i += 1
+        if not line or line.startswith("#"):
+            continue
+        words = line.split()
+        if words[0] == "height":
+            height = int(words[1])
+            if not 1 <= height <= MAX_HEIGHT:
+                raise FontError("%s:%d: height must be 1..%d" % (path, i, MAX_HEIGHT))
+            continue
+        if words[0] == "default":
+            default = parse_codepoint(words[1])
+            continue
+        if height is None:
+            raise FontError("%s:%d: 'height' must come before the first glyph" % (path, i))
+
+        cp = parse_codepoint(words[0])
+        if cp in glyphs:
+            raise FontError("%s:%d: U+%04X defined twice" % (path, i, cp))
+        rows = lines[i:i + height]
+        if len(rows) != height:
+            raise FontError("%s:%d: U+%04X needs %d rows" % (path, i, cp, height))
+        width = len(rows[0])
+        if not 1 <= width <= MAX_WIDTH or any(len(r) != width for r in rows):
+            raise FontError("%s:%d: U+%04X rows must all be 1..%d wide" % (path, i, cp, MAX_WIDTH))
+        cols = []
+        for x in range(width):
+            col = 0
+            for y in range(height):
+                if rows[y][x] == "#":
+                    col |= 1 << y
+            cols.append(col)
+        glyphs[cp] = cols
+        i += height
+
+    if not glyphs:
+        raise FontError("%s: no glyphs" % path)
+    if default not in glyphs:
+        raise FontError("%s: default glyph U+%04X is not defined" % (path, default))
+    return height, default, glyphs
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.n = 0
+
+    def put(self, value, bits):
+        for b in range(bits - 1, -1, -1):
+            self.acc = (self.acc << 1) | ((value >> b) & 1)
+            self.n += 1
+            if self.n == 8:
+                self.out.append(self.acc)
+                self.acc = 0
+                self.n = 0
+
+    def flush(self):
+        if self.n:
+            self.out.append(self.acc << (8 - self.n))
+            self.acc = 0
+            self.n = 0
+
+
+def reverse_bits(value, bits):
+    r = 0
+    for b in range(bits):
+        if value & (1 << b):
+            r |= 1 << (bits - 1 - b)
+    return r
+
+
+def encode_glyph(cols, height):
+    w = BitWriter()
+    prev = 0
+    for col in cols:
+        if col == prev:
+            w.put(0, 1)
+        else:
+            w.put(1, 1)
+            # top row (bit 0) goes first in the stream
+            w.put(reverse_bits(col, height), height)
+        prev = col
+    w.flush()
+    return bytes(w.out)
+
+
+def build(height, default, glyphs):
+    index = bytearray()
+    data = bytearray()
+    for cp in sorted(glyphs):
+        cols = glyphs[cp]
+        if len(data) >= 1 << 24:
+            raise FontError("glyph data exceeds 16 MiB")
+        index += struct.pack("<II", cp, len(data) | (len(cols) << 24))
+        data += encode_glyph(cols, height)
+    body = bytes(index + data)
+    header = HEADER.pack(MAGIC, VERSION, height, 0, len(glyphs), len(data),
+                         zlib.crc32(body) & 0xFFFFFFFF, default)
+    return header + body
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("source", help="text font, see fonts/default.txt")
+    ap.add_argument("-o", "--output", required=True, help="blob to write")
+    args = ap.parse_args()
+
+    try:
+        height, default, glyphs = parse(args.source)
+    except (FontError, ValueError) as e:
+        sys.exit("mkfont: %s" % e)
+
+    blob = build(height, default, glyphs)
+    with open(args.output, "wb") as f:
+        f.write(blob)
+    raw = sum(len(c) for c in glyphs.values())
+    print("mkfont: %d glyphs, %d bytes (%d bytes of glyph data, %d unpacked)"
+          % (len(glyphs), len(blob), len(blob) - HEADER.size - 8 * len(glyphs), raw))
+
+
+if __name__ == "__main__":
+    main()
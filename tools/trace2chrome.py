@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Convert a ClassPlate trace dump into Chrome trace JSON.
+
+The firmware (built with `idf.py -DTRACE=1 build`, see main/trace/trace.h)
+dumps its event ring on request:
+
+    mosquitto_sub -t /classplate/trace/<device> > dump.txt &
+    mosquitto_pub -t /classplate/cmd/<device>/trace -m dump
+
+or, with "print" instead of "dump", to the serial console as lines
+prefixed with "TRACE ". Either file works as input, console logs may
+contain other output around the trace:
+
+    python tools/trace2chrome.py dump.txt -o trace.json
+
+Open the result in chrome://tracing or https://ui.perfetto.dev. One row per
+task; spans are frames, commits, SPI transactions, lock waits, HTTP
+fetches and app loop events, instants mark MQTT events and clock ticks.
+
+Dump format, one record per line:
+
+    # classplate-trace 1 events=N lost=N cost_ns=N
+    T <task> <name>                        task handle -> name
+    <ts_us> <B|E|i> <event> <task> <arg>   ts is the low 32 bits of esp_timer
+    # end
+"""
+
+import argparse
+import json
+import sys
+
+
+def read_lines(path):
+    with open(path, "r", errors="replace") as f:
+        for line in f:
+            marker = line.find("TRACE ")
+            if marker >= 0:
+                line = line[marker + len("TRACE "):]
+            yield line.strip()
+
+
+def convert(lines):
+    tasks = {}
+    events = []
+    meta = {}
+    open_spans = {}   # (task, name) -> depth, to drop ends whose begin was lost
+    last_ts = None
+    wraps = 0
+
+    for line in lines:
+        if not line:
+            continue
+        if line.startswith("#"):
+            for field in line.split()[2:]:
+                key, _, value = field.partition("=")
+                if value.isdigit():
+                    meta[key] = int(value)
+            continue
+        parts = line.split()
+        if parts[0] == "T" and len(parts) == 3:
+            tasks[parts[1]] = parts[2]
+            continue
+        if len(parts) != 5 or parts[1] not in ("B", "E", "i") or not parts[0].isdigit():
+            continue
+
+        ts, phase, name, task, arg = int(parts[0]), parts[1], parts[2], parts[3], int(parts[4])
+        # 32 bit µs timestamps wrap every ~71 minutes
+        if last_ts is not None and ts + wraps * (1 << 32) < last_ts - (1 << 31):
+            wraps += 1
+        ts += wraps * (1 << 32)
+        last_ts = ts
+
+        key = (task, name)
+        if phase == "B":
+            open_spans[key] = open_spans.get(key, 0) + 1
+        elif phase == "E":
+            if open_spans.get(key, 0) == 0:
+                continue
+            open_spans[key] -= 1
+
+        event = {"name": name, "ph": phase, "ts": ts, "pid": 1,
+                 "tid": int(task, 16), "args": {"arg": arg}}
+        if phase == "i":
+            event["s"] = "t"
+        events.append(event)
+
+    if events:
+        base = events[0]["ts"]
+        for event in events:
+            event["ts"] -= base
+
+    for task in {e["tid"] for e in events}:
+        name = tasks.get("%08x" % task, "task %08x" % task)
+        events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": task,
+                       "args": {"name": name}})
+    events.append({"name": "process_name", "ph": "M", "pid": 1, "tid": 0,
+                   "args": {"name": "classplate"}})
+    return {"traceEvents": events, "displayTimeUnit": "ms", "otherData": meta}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("dump", nargs="+", help="MQTT dump or console log")
+    ap.add_argument("-o", "--output", required=True, help="Chrome trace JSON to write")
+    args = ap.parse_args()
+
+    lines = (line for path in args.dump for line in read_lines(path))
+    trace = convert(lines)
+    count = sum(1 for e in trace["traceEvents"] if e["ph"] != "M")
+    if count == 0:
+        sys.exit("trace2chrome: no trace records found")
+    with open(args.output, "w") as f:
+        json.dump(trace, f)
+    meta = trace["otherData"]
+    print("trace2chrome: %d events, %d lost to the ring, %s ns per record"
+          % (count, meta.get("lost", 0), meta.get("cost_ns", "?")))
+
+
+if __name__ == "__main__":
+    main()
@@ -3,22 +3,48 @@ const http = require("http");
 const mqtt = require("mqtt");
 const WebSocket = require("ws");
 const path = require("path");
+const crypto = require("crypto");
 
 const app = express();
 const server = http.createServer(app);
 const wss = new WebSocket.Server({ server });
 
 // MQTT Broker settings (using public broker for testing, replace with your own)
-const MQTT_BROKER = "mqtt://broker.hivemq.com:1883";
+const MQTT_BROKER = process.env.MQTT_BROKER || "mqtt://broker.hivemq.com:1883";
 const MQTT_TOPICS = {
-  MESSAGE: "/classplate/message",
-  INTENSITY: "/classplate/intensity",
+  // Commands: /classplate/cmd/{deviceId}/{kind}[/{jobId}], "all" broadcasts
+  CMD: "/classplate/cmd",
   STATUS: "/classplate/status",
+  ACK: "/classplate/ack",
+  TELEMETRY: "/classplate/telemetry",
+  // Weather: /classplate/weather/{location}, retained "temp,wind,fetched"
+  WEATHER: "/classplate/weather",
   // HEARTBEAT: "classplate/heartbeat",
 };
 
+const BROADCAST_ID = "all";
+// Message store size on the sign (main/message/message.h), in UTF-8 bytes.
+// Boards without PSRAM cut messages at 1 KB.
+const MESSAGE_MAX_BYTES = 8192;
+
+function validMessage(message) {
+  return (
+    typeof message === "string" &&
+    message.length > 0 &&
+    Buffer.byteLength(message, "utf8") <= MESSAGE_MAX_BYTES
+  );
+}
+
+function commandTopic(deviceId, kind, jobId) {
+  const topic = `${MQTT_TOPICS.CMD}/${deviceId}/${kind}`;
+  return jobId ? `${topic}/${jobId}` : topic;
+}
+
 // Store connected devices
 const devices = new Map();
+// Latest stack/heap telemetry per device, kept out of the device list so
+// it does not ride along on every dashboard update
+const telemetry = new Map();
 
 // Connect to MQTT broker
 const mqttClient = mqtt.connect(MQTT_BROKER, {
@@ -47,6 +73,13 @@ mqttClient.on("connect", () => {
   mqttClient.subscribe("/classplate/status/+", (err) => {
     if (!err) console.log("Subscribed to status topic");
   });
+  mqttClient.subscribe(MQTT_TOPICS.ACK + "/+", { qos: 1 }, (err) => {
+    if (!err) console.log("Subscribed to ack topic");
+  });
+  mqttClient.subscribe(MQTT_TOPICS.TELEMETRY + "/+", (err) => {
+    if (!err) console.log("Subscribed to telemetry topic");
+  });
+  publishCanned();
   // mqttClient.subscribe(MQTT_TOPICS.HEARTBEAT + "/+", (err) => {
   //   if (!err) console.log("Subscribed to heartbeat topic");
   // });
@@ -56,20 +89,47 @@ mqttClient.on("message", (topic, message) => {
   const msg = message.toString();
   console.log(`MQTT: ${topic} -> ${msg}`);
 
-  // Handle device status updates
+  // Delivery acknowledgements for fan-out jobs
+  if (topic.startsWith(MQTT_TOPICS.ACK + "/")) {
+    const deviceId = topic.split("/").pop();
+    try {
+      const ack = JSON.parse(msg);
+      handleAck(deviceId, String(ack.id), ack.ok !== false);
+    } catch (e) {
+      console.error("Failed to parse ack:", e);
+    }
+    return;
+  }
+
+  if (topic.startsWith(MQTT_TOPICS.TELEMETRY + "/")) {
+    const deviceId = topic.split("/").pop();
+    try {
+      telemetry.set(deviceId, { ...JSON.parse(msg), receivedAt: Date.now() });
+    } catch (e) {
+      console.error("Failed to parse telemetry:", e);
+    }
+    return;
+  }
+
+  // Handle device status updates. Status is retained: the device publishes
+  // {"online":true} on connect and the broker publishes its Last Will
+  // {"online":false} when the connection drops, so the flag is taken as is.
+  // On startup the retained statuses rebuild the whole fleet at once.
   if (topic.startsWith(MQTT_TOPICS.STATUS)) {
     const deviceId = topic.split("/").pop();
+    if (!message.length) {
+      return; // retained status cleared
+    }
     try {
-      const status = JSON.parse(msg);
+      const { online, ...status } = JSON.parse(msg);
       devices.set(deviceId, {
         ...devices.get(deviceId),
         ...status,
+        reported: online !== false,
         lastSeen: Date.now(),
       });
-      broadcastToWebClients({
-        type: "device_update",
-        devices: getDeviceList(),
-      });
+      markDeviceDirty(deviceId);
+      if (typeof status.loc === "string") addWeatherLocation(status.loc.toLowerCase());
     } catch (e) {
       console.error("Failed to parse status:", e);
     }
@@ -90,35 +150,334 @@ mqttClient.on("error", (err) => {
   console.error("MQTT error:", err);
 });
 
-// Check device online status periodically
+// Device state is pushed to the dashboards as deltas: every device keeps
+// the JSON of the last view that was sent, and only devices whose view
+// changed go out, serialized once for all clients. A full snapshot still
+// goes out every SNAPSHOT_INTERVAL (and on connect or on request) so a
+// client that missed a delta resyncs. seq lets clients spot a gap.
+// The Last Will reports a lost device right away; the timeout only covers
+// a device whose broker connection is gone too (three missed heartbeats).
+const OFFLINE_AFTER = 3 * 60000;
+const SWEEP_INTERVAL = 5000;
+const SNAPSHOT_INTERVAL = 60000;
+
+const sentViews = new Map(); // deviceId -> JSON of the last view pushed
+const dirtyDevices = new Set();
+let flushScheduled = false;
+let broadcastSeq = 0;
+
+function deviceView(id, device, now) {
+  return { id, ...device, online: isOnline(device, now) };
+}
+
+function isOnline(device, now) {
+  return device.reported !== false && now - device.lastSeen < OFFLINE_AFTER;
+}
+
+function getDeviceList() {
+  const now = Date.now();
+  return Array.from(devices.entries()).map(([id, device]) =>
+    deviceView(id, device, now)
+  );
+}
+
+// Coalesce everything that changes in one tick (e.g. a burst of status
+// messages) into a single delta.
+function markDeviceDirty(id) {
+  dirtyDevices.add(id);
+  if (!flushScheduled) {
+    flushScheduled = true;
+    setImmediate(flushDeviceDeltas);
+  }
+}
+
+function flushDeviceDeltas() {
+  flushScheduled = false;
+  const now = Date.now();
+  const changed = [];
+  const removed = [];
+
+  dirtyDevices.forEach((id) => {
+    const device = devices.get(id);
+    if (!device) {
+      if (sentViews.delete(id)) removed.push(id);
+      return;
+    }
+    const view = deviceView(id, device, now);
+    const json = JSON.stringify(view);
+    if (sentViews.get(id) !== json) {
+      sentViews.set(id, json);
+      changed.push(view);
+    }
+  });
+  dirtyDevices.clear();
+
+  if (changed.length === 0 && removed.length === 0) return;
+  broadcastToWebClients({
+    type: "device_delta",
+    seq: ++broadcastSeq,
+    devices: changed,
+    removed,
+  });
+}
+
+function snapshotMessage() {
+  return { type: "device_update", seq: broadcastSeq, devices: getDeviceList() };
+}
+
+// Only online -> offline transitions need a sweep, everything else is
+// caught where it happens.
 setInterval(() => {
   const now = Date.now();
   devices.forEach((device, id) => {
-    if (now - device.lastSeen > 15000) {
-      // 15 seconds timeout
-      device.online = false;
-      devices.set(id, device);
+    const online = isOnline(device, now);
+    if (device.online !== online) {
+      device.online = online;
+      markDeviceDirty(id);
     }
   });
-  broadcastToWebClients({ type: "device_update", devices: getDeviceList() });
-}, 5000);
+}, SWEEP_INTERVAL);
 
-function getDeviceList() {
-  return Array.from(devices.entries()).map(([id, device]) => ({
-    id,
-    ...device,
-    online: Date.now() - device.lastSeen < 15000,
-  }));
-}
+setInterval(() => {
+  if (wss.clients.size > 0) broadcastToWebClients(snapshotMessage());
+}, SNAPSHOT_INTERVAL);
 
 function broadcastToWebClients(data) {
+  const payload = JSON.stringify(data); // once, not per client
   wss.clients.forEach((client) => {
     if (client.readyState === WebSocket.OPEN) {
-      client.send(JSON.stringify(data));
+      client.send(payload);
+    }
+  });
+}
+
+// Fleet fan-out. A job sends one command (message and/or intensity) to a
+// list of devices and groups. Publishes go through one queue shared by all
+// jobs, limited to FANOUT_MAX_IN_FLIGHT unacknowledged (by the broker)
+// publishes and FANOUT_RATE per second, so a large job cannot flood the
+// broker. Each device's copy goes to <topic>/<deviceId>/<jobId>; the
+// device applies it and answers on /classplate/ack/<deviceId> with
+// {"id": jobId, "ok": true}. Devices that do not answer within
+// FANOUT_ACK_TIMEOUT are reported as timed out.
+const FANOUT_MAX_IN_FLIGHT = 32;
+const FANOUT_RATE = 200; // publishes per second
+const FANOUT_ACK_TIMEOUT = 15000;
+const FANOUT_JOB_TTL = 10 * 60 * 1000; // keep finished jobs for polling
+
+const groups = new Map(); // name -> Set of device ids
+const jobs = new Map();   // jobId -> job
+const publishQueue = [];  // { job, deviceId }
+let publishInFlight = 0;
+let publishTokens = FANOUT_RATE;
+let jobCounter = 0;
+
+setInterval(() => {
+  publishTokens = Math.min(FANOUT_RATE, publishTokens + FANOUT_RATE / 10);
+  pumpPublishQueue();
+}, 100);
+
+function resolveTargets(deviceIds = [], groupNames = []) {
+  const targets = new Set(deviceIds);
+  for (const name of groupNames) {
+    if (name === "all") {
+      devices.forEach((_, id) => targets.add(id));
+    } else if (!groups.has(name)) {
+      throw new Error(`Unknown group '${name}'`);
+    } else {
+      groups.get(name).forEach((id) => targets.add(id));
+    }
+  }
+  return Array.from(targets);
+}
+
+function startFanout(targets, command) {
+  const id = (++jobCounter).toString(36) + Date.now().toString(36);
+  const job = {
+    id,
+    command,
+    created: Date.now(),
+    finished: null,
+    results: new Map(targets.map((d) => [d, { state: "queued" }])),
+    pendingAcks: new Set(),
+  };
+  jobs.set(id, job);
+  targets.forEach((deviceId) => publishQueue.push({ job, deviceId }));
+  pumpPublishQueue();
+  maybeFinishJob(job);
+  return job;
+}
+
+function pumpPublishQueue() {
+  while (
+    publishQueue.length > 0 &&
+    publishInFlight < FANOUT_MAX_IN_FLIGHT &&
+    publishTokens >= 1
+  ) {
+    const { job, deviceId } = publishQueue.shift();
+    publishTokens -= 1;
+    publishInFlight++;
+    publishCommand(job, deviceId);
+  }
+}
+
+function publishCommand(job, deviceId) {
+  const result = job.results.get(deviceId);
+  const publishes = [];
+  if (job.command.intensity !== undefined) {
+    publishes.push(["intensity", job.command.intensity.toString()]);
+  }
+  if (job.command.gray !== undefined) {
+    publishes.push(["gray", job.command.gray.toString()]);
+  }
+  if (job.command.message !== undefined) {
+    publishes.push(["message", job.command.message]);
+  }
+  if (job.command.show !== undefined) {
+    // Only the id to signs holding the current list, the text to the rest
+    const device = devices.get(deviceId);
+    if (device && device.cv === canned.version) {
+      publishes.push(["show", String(job.command.show)]);
+    } else {
+      publishes.push(["message", cannedText(job.command.show)]);
+    }
+  }
+
+  // The device acks once per topic; the last one completes the delivery.
+  let remaining = publishes.length;
+  result.acksExpected = publishes.length;
+  publishes.forEach(([kind, payload]) => {
+    // The same content is kept retained on the device's topic without a
+    // job id, so a device that reboots or resubscribes restores it from the
+    // broker. The device ignores it when it already shows it, and does not
+    // ack it.
+    mqttClient.publish(commandTopic(deviceId, kind), payload, { qos: 1, retain: true });
+    // A message and a canned one replace each other; keep only the latest
+    // retained, or a reboot could bring back the older one
+    const replaced = { message: "show", show: "message" }[kind];
+    if (replaced) {
+      mqttClient.publish(commandTopic(deviceId, replaced), "", { qos: 1, retain: true });
     }
+
+    const topic = commandTopic(deviceId, kind, job.id);
+    mqttClient.publish(topic, payload, { qos: 1 }, (err) => {
+      if (--remaining === 0) {
+        publishInFlight--;
+        setImmediate(pumpPublishQueue);
+      }
+      if (err) {
+        result.state = "failed";
+        result.error = err.message;
+        maybeFinishJob(job);
+        return;
+      }
+      if (result.state === "queued") {
+        result.state = "published";
+        job.pendingAcks.add(deviceId);
+        result.timer = setTimeout(() => {
+          if (result.state === "published") {
+            result.state = "timeout";
+            job.pendingAcks.delete(deviceId);
+            maybeFinishJob(job);
+          }
+        }, FANOUT_ACK_TIMEOUT);
+      }
+    });
   });
 }
 
+function handleAck(deviceId, jobId, ok) {
+  const job = jobs.get(jobId);
+  const result = job && job.results.get(deviceId);
+  if (!result || result.state !== "published") return;
+  if (ok && --result.acksExpected > 0) return;
+
+  clearTimeout(result.timer);
+  delete result.timer;
+  result.state = ok ? "acked" : "failed";
+  result.latency = Date.now() - job.created;
+  job.pendingAcks.delete(deviceId);
+  maybeFinishJob(job);
+}
+
+function maybeFinishJob(job) {
+  if (job.finished) return;
+  for (const r of job.results.values()) {
+    if (r.state === "queued" || r.state === "published") return;
+  }
+  job.finished = Date.now();
+  setTimeout(() => jobs.delete(job.id), FANOUT_JOB_TTL);
+}
+
+function jobSummary(job, withDevices) {
+  const counts = { queued: 0, published: 0, acked: 0, failed: 0, timeout: 0 };
+  const perDevice = {};
+  job.results.forEach((r, deviceId) => {
+    counts[r.state]++;
+    if (withDevices) {
+      perDevice[deviceId] = { state: r.state, latency: r.latency, error: r.error };
+    }
+  });
+  const summary = {
+    jobId: job.id,
+    total: job.results.size,
+    done: job.finished !== null,
+    elapsed: (job.finished || Date.now()) - job.created,
+    ...counts,
+  };
+  if (withDevices) summary.devices = perDevice;
+  return summary;
+}
+
+function validateCommand({ message, intensity, show, gray }) {
+  const command = {};
+  if (message !== undefined) {
+    if (!validMessage(message)) {
+      throw new Error(`Message must be 1-${MESSAGE_MAX_BYTES} bytes`);
+    }
+    command.message = message;
+  }
+  if (show !== undefined) {
+    if (message !== undefined || cannedText(show) === undefined) {
+      throw new Error("show needs a canned message id and no message");
+    }
+    command.show = Number(show);
+  }
+  if (intensity !== undefined) {
+    const intensityVal = parseInt(intensity);
+    if (isNaN(intensityVal) || intensityVal < 0 || intensityVal > 15) {
+      throw new Error("Intensity must be 0-15");
+    }
+    command.intensity = intensityVal;
+  }
+  if (gray !== undefined) {
+    // Bit-planes of the sign's grayscale mode, 0 = off (main/gray)
+    if (![0, 2, 3].includes(Number(gray))) {
+      throw new Error("gray must be 0, 2 or 3");
+    }
+    command.gray = Number(gray);
+  }
+  if (Object.keys(command).length === 0) {
+    throw new Error("Nothing to send, give a message (or show) and/or intensity");
+  }
+  return command;
+}
+
+// Single device or the whole fleet, as the dashboard asks for it. Empty
+// while no device has reported in yet.
+function dashboardTargets(deviceId) {
+  if (deviceId) return [deviceId];
+  return resolveTargets([], ["all"]);
+}
+
+// Without known devices there is nobody to track acks for: send it once on
+// the broadcast topic instead. Not retained, so it never shadows a
+// device's own retained content.
+function broadcastCommand(kind, payload) {
+  const topic = commandTopic(BROADCAST_ID, kind);
+  mqttClient.publish(topic, payload, { qos: 1 });
+  return topic;
+}
+
 // Serve static files
 app.use(express.static(path.join(__dirname, "public")));
 app.use(express.json());
@@ -127,53 +486,358 @@ app.use(express.json());
 app.post("/api/message", (req, res) => {
   const { deviceId, message } = req.body;
 
-  if (!message || message.length > 32) {
-    return res.status(400).json({ error: "Message must be 1-32 characters" });
+  if (!validMessage(message)) {
+    return res.status(400).json({ error: `Message must be 1-${MESSAGE_MAX_BYTES} bytes` });
   }
 
-  // const topic = deviceId
-  //   ? `${MQTT_TOPICS.MESSAGE}/${deviceId}`
-  //   : MQTT_TOPICS.MESSAGE;
-
-  // EXTEND FUNCTIONALIY OF STORING ALL CLIENTS AND HANDLE THEM SEPERATLY
-  // AS OF NOW WE ARE HARDCODED THE CLIENT ID AS 'device1'
-
-  const topic = `${MQTT_TOPICS.MESSAGE}/device1`
-  mqttClient.publish(topic, message, { qos: 1 });
+  const targets = dashboardTargets(deviceId);
+  if (targets.length === 0) {
+    const topic = broadcastCommand("message", message);
+    restartScrollSync();
+    return res.json({ success: true, broadcast: topic, message });
+  }
+  const job = startFanout(targets, { message });
+  restartScrollSync();
 
-  console.log(`Published message to ${topic}: ${message}`);
-  res.json({ success: true, topic, message });
+  console.log(`Fan-out ${job.id}: message to ${targets.length} device(s): ${message.slice(0, 40)}`);
+  res.json({ success: true, jobId: job.id, devices: targets, message });
 });
 
 app.post("/api/intensity", (req, res) => {
-  // const { deviceId, intensity } = req.body;
-  const { _, intensity } = req.body;
-  const deviceId = "device1"
+  const { deviceId, intensity } = req.body;
   const intensityVal = parseInt(intensity);
   if (isNaN(intensityVal) || intensityVal < 0 || intensityVal > 15) {
     return res.status(400).json({ error: "Intensity must be 0-15" });
   }
 
-  // const topic = deviceId
-  //   ? `${MQTT_TOPICS.INTENSITY}/${deviceId}`
-  //   : MQTT_TOPICS.INTENSITY;
-  const topic = `${MQTT_TOPICS.INTENSITY}/${deviceId}`;
-  mqttClient.publish(topic, intensityVal.toString(), { qos: 1 });
+  const targets = dashboardTargets(deviceId);
+  if (targets.length === 0) {
+    const topic = broadcastCommand("intensity", intensityVal.toString());
+    return res.json({ success: true, broadcast: topic, intensity: intensityVal });
+  }
+  const job = startFanout(targets, { intensity: intensityVal });
+
+  console.log(`Fan-out ${job.id}: intensity to ${targets.length} device(s): ${intensityVal}`);
+  res.json({ success: true, jobId: job.id, devices: targets, intensity: intensityVal });
+});
+
+// { devices: ["a", "b"], groups: ["floor2"], message: "HI", intensity: 4, gray: 3 }
+app.post("/api/fanout", (req, res) => {
+  const { devices: deviceIds = [], groups: groupNames = [] } = req.body;
+  if (!Array.isArray(deviceIds) || !Array.isArray(groupNames)) {
+    return res.status(400).json({ error: "devices and groups must be arrays" });
+  }
+
+  let command, targets;
+  try {
+    command = validateCommand(req.body);
+    targets = resolveTargets(deviceIds.map(String), groupNames.map(String));
+  } catch (e) {
+    return res.status(400).json({ error: e.message });
+  }
+  if (targets.length === 0) {
+    return res.status(400).json({ error: "No target devices" });
+  }
+
+  const job = startFanout(targets, command);
+  console.log(`Fan-out ${job.id}: ${targets.length} device(s)`);
+  res.status(202).json(jobSummary(job, false));
+});
+
+app.get("/api/fanout/:jobId", (req, res) => {
+  const job = jobs.get(req.params.jobId);
+  if (!job) return res.status(404).json({ error: "Unknown job" });
+  res.json(jobSummary(job, req.query.devices !== "0"));
+});
+
+app.get("/api/groups", (req, res) => {
+  const list = {};
+  groups.forEach((members, name) => (list[name] = Array.from(members)));
+  res.json({ groups: list });
+});
+
+app.put("/api/groups/:name", (req, res) => {
+  const { devices: members } = req.body;
+  if (req.params.name === "all") {
+    return res.status(400).json({ error: "'all' is built in" });
+  }
+  if (!Array.isArray(members)) {
+    return res.status(400).json({ error: "devices must be an array" });
+  }
+  groups.set(req.params.name, new Set(members.map(String)));
+  res.json({ success: true, name: req.params.name, devices: members });
+});
+
+app.delete("/api/groups/:name", (req, res) => {
+  res.json({ success: groups.delete(req.params.name) });
+});
+
+// Night windows: { dim: { from: "22:00", to: "06:00", intensity: 1 },
+//                 off: { from: "01:00", to: "05:00" } }, both optional.
+app.post("/api/schedule", (req, res) => {
+  const { deviceId, dim, off } = req.body;
+  const hhmm = /^([01]?\d|2[0-3]):[0-5]\d$/;
+  const validWindow = (w) => !w || (hhmm.test(w.from) && hhmm.test(w.to));
+
+  if (!validWindow(dim) || !validWindow(off)) {
+    return res.status(400).json({ error: "Windows need from/to as HH:MM" });
+  }
+  if (dim) {
+    const level = parseInt(dim.intensity);
+    if (isNaN(level) || level < 0 || level > 15) {
+      return res.status(400).json({ error: "Dim intensity must be 0-15" });
+    }
+    dim.intensity = level;
+  }
+
+  // Retained, so devices that join later or reboot pick it up. Without a
+  // deviceId it goes to the whole fleet.
+  const topic = commandTopic(deviceId || BROADCAST_ID, "schedule");
+  const schedule = {};
+  if (dim) schedule.dim = { from: dim.from, to: dim.to, intensity: dim.intensity };
+  if (off) schedule.off = { from: off.from, to: off.to };
+  mqttClient.publish(topic, JSON.stringify(schedule), { qos: 1, retain: true });
+
+  console.log(`Published schedule to ${topic}: ${JSON.stringify(schedule)}`);
+  res.json({ success: true, topic, schedule });
+});
+
+// Canned messages (main/canned): the signs keep this list rendered and
+// are sent a message's id instead of its text. The version is a hash of
+// the list, so a restarted server with the same list matches what the
+// signs already hold, and a sign reports the version it has ("cv").
+const CANNED_MAX = 64;
+const CANNED_BYTES_MAX = 4096;
+const CANNED_ID_MAX = 9999;
+let canned = makeCanned(
+  ["HELLO", "CLASS", "BREAK", "LUNCH", "BUSY", "OPEN"].map((text, i) => ({ id: i + 1, text }))
+);
+
+function makeCanned(messages) {
+  const body = messages.map(({ id, text }) => `${id}\t${text}`).join("\n");
+  const hash = crypto.createHash("sha1").update(body).digest().readUInt32BE(0);
+  const version = hash || 1; // 0 means "none" on the sign
+  return { version, messages, payload: `${version}\n${body}` };
+}
+
+function cannedText(id) {
+  const entry = canned.messages.find((m) => m.id === Number(id));
+  return entry && entry.text;
+}
+
+function publishCanned() {
+  mqttClient.publish(commandTopic(BROADCAST_ID, "canned"), canned.payload, {
+    qos: 1,
+    retain: true,
+  });
+}
+
+app.get("/api/canned", (req, res) => {
+  res.json({ version: canned.version, messages: canned.messages });
+});
+
+// Replace the list: { messages: [{ id, text }, ...] }
+app.put("/api/canned", (req, res) => {
+  const { messages } = req.body;
+  const ids = new Set();
+  const valid =
+    Array.isArray(messages) &&
+    messages.length <= CANNED_MAX &&
+    messages.every(
+      (m) =>
+        Number.isInteger(m.id) &&
+        m.id >= 0 &&
+        m.id <= CANNED_ID_MAX &&
+        !ids.has(m.id) &&
+        ids.add(m.id) &&
+        typeof m.text === "string" &&
+        m.text.length > 0 &&
+        !/[\t\n]/.test(m.text)
+    );
+  if (!valid) {
+    return res.status(400).json({
+      error: `Up to ${CANNED_MAX} messages with unique ids 0-${CANNED_ID_MAX} and one-line text`,
+    });
+  }
+  const next = makeCanned(messages.map(({ id, text }) => ({ id, text })));
+  if (Buffer.byteLength(next.payload, "utf8") > CANNED_BYTES_MAX) {
+    return res.status(400).json({ error: `The list must fit in ${CANNED_BYTES_MAX} bytes` });
+  }
+  canned = next;
+  publishCanned();
+  console.log(`Canned messages: version ${canned.version}, ${messages.length} message(s)`);
+  res.json({ success: true, version: canned.version });
+});
+
+app.post("/api/canned/show", (req, res) => {
+  const { deviceId, id } = req.body;
+  const text = cannedText(id);
+  if (text === undefined) {
+    return res.status(400).json({ error: "Unknown canned message" });
+  }
+
+  const targets = dashboardTargets(deviceId);
+  if (targets.length === 0) {
+    // Nobody reported a version yet, so the text it is
+    const topic = broadcastCommand("message", text);
+    restartScrollSync();
+    return res.json({ success: true, broadcast: topic, message: text });
+  }
+  const job = startFanout(targets, { show: Number(id) });
+  restartScrollSync();
 
-  console.log(`Published intensity to ${topic}: ${intensityVal}`);
-  res.json({ success: true, topic, intensity: intensityVal });
+  console.log(`Fan-out ${job.id}: canned ${id} to ${targets.length} device(s)`);
+  res.json({ success: true, jobId: job.id, devices: targets, message: text });
+});
+
+// Synchronized scrolling across a wall of signs (main/scroll_sync). The
+// signs compute the marquee column from their own clock, so the server
+// only hands out an epoch and a column period, plus each sign's offset in
+// the wall. The epoch lies SYNC_LEAD ahead so every sign has it (and the
+// message) before the scroll starts.
+const SYNC_LEAD = 2000;
+const SYNC_PERIOD_DEFAULT = 80; // ms per column, the free-running speed
+let scrollSync = null; // { epoch, period } while the wall is synced
+
+function publishScrollSync() {
+  const payload = scrollSync ? `${scrollSync.epoch},${scrollSync.period}` : "off";
+  mqttClient.publish(commandTopic(BROADCAST_ID, "sync"), payload, { qos: 1, retain: true });
+}
+
+// A new message starts at the right end of the wall on every sign at once
+function restartScrollSync() {
+  if (!scrollSync) return;
+  scrollSync.epoch = Date.now() + SYNC_LEAD;
+  publishScrollSync();
+}
+
+// { period: 80 } starts (or restarts) the synced scroll, { off: true } stops it
+app.post("/api/sync", (req, res) => {
+  const { period, off } = req.body;
+  if (off) {
+    scrollSync = null;
+  } else {
+    const ms = period === undefined ? SYNC_PERIOD_DEFAULT : parseInt(period);
+    if (isNaN(ms) || ms < 20 || ms > 1000) {
+      return res.status(400).json({ error: "Period must be 20-1000 ms" });
+    }
+    scrollSync = { epoch: Date.now() + SYNC_LEAD, period: ms };
+  }
+  publishScrollSync();
+  console.log(`Scroll sync: ${scrollSync ? JSON.stringify(scrollSync) : "off"}`);
+  res.json({ success: true, sync: scrollSync });
+});
+
+// { deviceId, offset }: columns between the sign and the wall's right end,
+// 32 for each sign to its right
+app.post("/api/wall", (req, res) => {
+  const { deviceId, offset } = req.body;
+  const cols = parseInt(offset);
+  if (!deviceId || deviceId === BROADCAST_ID || isNaN(cols) || cols < 0) {
+    return res.status(400).json({ error: "Need a deviceId and an offset >= 0" });
+  }
+  mqttClient.publish(commandTopic(deviceId, "wall"), String(cols), { qos: 1, retain: true });
+  res.json({ success: true, deviceId, offset: cols });
 });
 
 app.get("/api/devices", (req, res) => {
   res.json({ devices: getDeviceList() });
 });
 
+// Stack high-water marks and heap per capability, see main/telemetry
+app.get("/api/devices/:id/telemetry", (req, res) => {
+  const t = telemetry.get(req.params.id);
+  if (!t) {
+    return res.status(404).json({ error: "No telemetry for this device yet" });
+  }
+  res.json({ id: req.params.id, ...t });
+});
+
+// Weather is fetched here once per location and pushed to the signs
+// (retained, so a sign that boots gets it at once) instead of every sign
+// calling the API on its own. Locations come from WEATHER_LOCATIONS and
+// from the "loc" the signs report in their status.
+const WEATHER_API_KEY = process.env.WEATHER_API_KEY || "";
+const WEATHER_URL = process.env.WEATHER_URL || "https://weather.indianapi.in/global/current";
+const WEATHER_INTERVAL = 10 * 60000;
+// Same rule as mqtt_location_normalize() in the firmware, which lower-cases
+// the configured location before subscribing
+const WEATHER_LOCATION_RE = /^[a-z0-9_-]{1,31}$/;
+
+const weather = new Map(); // location -> { temp, wind_speed, fetched } or null
+const badLocations = new Set(); // logged once
+
+function addWeatherLocation(location) {
+  if (weather.has(location)) return;
+  if (!WEATHER_LOCATION_RE.test(location)) {
+    if (!badLocations.has(location)) {
+      badLocations.add(location);
+      console.warn(`Weather location "${location}" is not [a-z0-9_-], not fetched`);
+    }
+    return;
+  }
+  weather.set(location, null);
+  fetchWeather(location);
+}
+
+async function fetchWeather(location) {
+  if (!WEATHER_API_KEY) return;
+  try {
+    const res = await fetch(`${WEATHER_URL}?location=${encodeURIComponent(location)}`, {
+      headers: { "x-api-key": WEATHER_API_KEY },
+      signal: AbortSignal.timeout(10000),
+    });
+    if (!res.ok) throw new Error(`HTTP ${res.status}`);
+    const body = await res.json();
+    const temp = Math.round(body.temperature);
+    const wind = Math.round(body.wind_speed);
+    if (!Number.isFinite(temp) || !Number.isFinite(wind)) {
+      throw new Error("no temperature/wind_speed in the response");
+    }
+    const fetched = Math.floor(Date.now() / 1000);
+    weather.set(location, { temp, wind_speed: wind, fetched });
+    mqttClient.publish(`${MQTT_TOPICS.WEATHER}/${location}`, `${temp},${wind},${fetched}`, {
+      qos: 1,
+      retain: true,
+    });
+    console.log(`Weather for ${location}: ${temp} C, wind ${wind}`);
+  } catch (e) {
+    // The signs fall back to fetching it themselves once the push is stale
+    console.error(`Weather for ${location} failed:`, e.message);
+  }
+}
+
+for (const location of (process.env.WEATHER_LOCATIONS || "jalandhar").split(",")) {
+  addWeatherLocation(location.trim().toLowerCase());
+}
+if (!WEATHER_API_KEY) {
+  console.log("WEATHER_API_KEY not set, signs fetch the weather themselves");
+}
+setInterval(() => {
+  for (const location of weather.keys()) fetchWeather(location);
+}, WEATHER_INTERVAL);
+
+app.get("/api/weather", (req, res) => {
+  res.json({ weather: Object.fromEntries(weather) });
+});
+
 // WebSocket connection handling
 wss.on("connection", (ws) => {
   console.log("Web client connected");
 
   // Send current device list
-  ws.send(JSON.stringify({ type: "device_update", devices: getDeviceList() }));
+  ws.send(JSON.stringify(snapshotMessage()));
+
+  // A client that saw a gap in seq asks for a fresh snapshot
+  ws.on("message", (raw) => {
+    try {
+      if (JSON.parse(raw.toString()).type === "resync") {
+        ws.send(JSON.stringify(snapshotMessage()));
+      }
+    } catch (e) {
+      // ignore anything that is not ours
+    }
+  });
 
   ws.on("close", () => {
     console.log("Web client disconnected");